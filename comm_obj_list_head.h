@@ -119,6 +119,24 @@ class ListHead {
     InitListHead();
   }
 
+  // list_splice_tail_init - join two lists and reinitialise the emptied list
+  // @self: the new list to add.
+  // @head: the place to add it in the first list.
+  // Each list is a queue, the list at @self is appended to @head's tail.
+  void ListSpliceTailInit(ListHead *head) {
+    if (ListEmpty()) {
+      return;
+    }
+    ListHead *first = GetNextObject();
+    ListHead *last = GetPrevObject();
+    ListHead *at = head->GetPrevObject();
+    first->SetPrev(at->Self());
+    at->SetNext(first->Self());
+    last->SetNext(head->Self());
+    head->SetPrev(last->Self());
+    InitListHead();
+  }
+
  protected:
   // Insert a new entry between two known consecutive entries.
   // This is only for internal list manipulation where we know
@@ -9,10 +9,41 @@
 #include "comm_base.h"
 #include "singleton.h"
 
+// ExpiryAction::OnExpiryReschedule的返回值, >=0表示多少Millis之后再次触发
+enum TimerReschedule {
+  TIMER_RESCHEDULE_STOP = -1,    // 结束, 循环timer也不再触发
+  TIMER_RESCHEDULE_REPEAT = -2,  // 按原来的方式处理: 循环timer按interval续期, 否则结束
+};
+
 class ExpiryAction {
  public:
   virtual ~ExpiryAction() = default;
+  // @timer_globalid timer id, 被slab复用过的timer带generation, 用TimerSystemInterface::GetTimer取对象
   virtual void OnExpiry(int32_t timer_globalid, int64_t user_data) = 0;
+
+  // RunTimers实际调用的入口, 默认调用OnExpiry并按interval处理
+  // 返回>=0时timer对象原地重新挂载, 不需要在回调里ClearTimer+SetTimer或ResetTimer
+  // @return TimerReschedule, 或者下一次触发距离现在的Millis
+  virtual int64_t OnExpiryReschedule(int32_t timer_globalid, int64_t user_data) {
+    OnExpiry(timer_globalid, user_data);
+    return TIMER_RESCHEDULE_REPEAT;
+  }
+
+  // 回调耗时统计(ExpiryProfiler)按这个名字聚合, 默认nullptr表示用RTTI类型名
+  virtual const char *Tag() const { return nullptr; }
+};
+
+// 回调自己决定下一次触发时间的action, 适合退避重试, AI思考间隔, 动态心跳
+// 返回值作用在触发它的那个timer上, 和timer是不是循环timer无关
+class ReschedulingExpiryAction : public ExpiryAction {
+ public:
+  virtual int64_t OnExpiryReschedule(int32_t timer_globalid, int64_t user_data) override = 0;
+
+ private:
+  // 忽略返回值
+  virtual void OnExpiry(int32_t timer_globalid, int64_t user_data) final {
+    OnExpiryReschedule(timer_globalid, user_data);
+  }
 };
 
 // example:
@@ -20,8 +51,7 @@ class ExpiryAction {
 // public:
 //  virtual ~ExpriyActionTest(){};
 //  void OnExpiry(int32_t timer_globalid, int64_t data) override {
-//    Timer* timer =
-//        dynamic_cast<Timer*>(CIDRuntimeClass::GetObjFromGlobalID(timer_globalid, EOT_OBJ_TIMER));
+//    Timer* timer = timers_->GetTimer(timer_globalid);
 //    printf("callback timer:%s now:(%s, %ld), data:%lu\n", timer->DebugString().c_str(),
 //           Clock::CurrentTimeString(0).c_str(), Clock::CurrentTimeMillis(), data);
 //    int64_t diff = Clock::CurrentTimeMillis() - (int64_t)timer->Expires();
@@ -31,5 +61,6 @@ class ExpiryAction {
 //  }
 //
 // public:
+//  TimerSystemInterface* timers_ = nullptr;
 //  int32_t num_ = 0;
 //};
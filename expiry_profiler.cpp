@@ -0,0 +1,179 @@
+#include "expiry_profiler.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <typeinfo>
+#include "lib_str.h"
+
+ExpiryProfiler::ExpiryProfiler() {
+  enabled_ = false;
+  cycles_per_us_ = 1.0;
+  slow_threshold_us_ = 0;
+  slow_threshold_cycles_ = 0;
+  Reset();
+}
+
+int64_t ExpiryProfiler::NowNs() {
+  auto now = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+}
+
+void ExpiryProfiler::Calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+  int64_t start_ns = NowNs();
+  uint64_t start = Now();
+  int64_t end_ns = start_ns;
+  while (end_ns - start_ns < 1000000) {
+    end_ns = NowNs();
+  }
+  uint64_t end = Now();
+  cycles_per_us_ = static_cast<double>(end - start) * 1000.0 / (end_ns - start_ns);
+#else
+  cycles_per_us_ = 1000.0;
+#endif
+  slow_threshold_cycles_ = static_cast<uint64_t>(slow_threshold_us_ * cycles_per_us_);
+}
+
+void ExpiryProfiler::Enable(bool enable) {
+  if (enable && !enabled_) {
+    Calibrate();
+  }
+  enabled_ = enable;
+}
+
+void ExpiryProfiler::SetSlowThresholdUs(int64_t us) {
+  slow_threshold_us_ = us > 0 ? us : 0;
+  slow_threshold_cycles_ = static_cast<uint64_t>(slow_threshold_us_ * cycles_per_us_);
+}
+
+void ExpiryProfiler::Reset() {
+  dropped_types_ = 0;
+  memset(types_, 0, sizeof(types_));
+  memset(slow_log_, 0, sizeof(slow_log_));
+  slow_log_pos_ = 0;
+}
+
+const char* ExpiryProfiler::ActionName(ExpiryAction* action) {
+  const char* tag = action->Tag();
+  if (tag) {
+    return tag;
+  }
+  return typeid(*action).name();
+}
+
+// 类型名都是静态字符串, 按指针做开放寻址
+ExpiryProfiler::TypeEntry* ExpiryProfiler::FindEntry(const char* name) {
+  uint64_t hash = reinterpret_cast<uintptr_t>(name) * 0x9E3779B97F4A7C15ULL;
+  uint32_t idx = static_cast<uint32_t>(hash >> 32) & (EXPIRY_PROFILER_TYPES - 1);
+  for (int i = 0; i < EXPIRY_PROFILER_TYPES; i++) {
+    TypeEntry* entry = &types_[(idx + i) & (EXPIRY_PROFILER_TYPES - 1)];
+    if (entry->name == name) {
+      return entry;
+    }
+    if (!entry->name) {
+      entry->name = name;
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+void ExpiryProfiler::Record(const char* name, int32_t timer_id, int64_t user_data,
+                            int64_t jiffies, uint64_t start) {
+  uint64_t cycles = Now() - start;
+  TypeEntry* entry = FindEntry(name);
+  if (!entry) {
+    dropped_types_++;
+    return;
+  }
+
+  entry->count++;
+  entry->total_cycles += cycles;
+  if (cycles > entry->max_cycles)
+    entry->max_cycles = cycles;
+  int bucket = cycles ? 64 - __builtin_clzll(cycles) : 0;
+  if (bucket >= EXPIRY_PROFILER_HIST_BITS)
+    bucket = EXPIRY_PROFILER_HIST_BITS - 1;
+  entry->hist[bucket]++;
+
+  if (slow_threshold_cycles_ && cycles >= slow_threshold_cycles_) {
+    entry->slow_count++;
+    ExpirySlowRecord* record = &slow_log_[slow_log_pos_++ % EXPIRY_PROFILER_SLOW_LOG];
+    record->name = name;
+    record->timer_id = timer_id;
+    record->user_data = user_data;
+    record->jiffies = jiffies;
+    record->cycles = cycles;
+  }
+}
+
+uint64_t ExpiryProfiler::Percentile(const TypeEntry& entry, double ratio) {
+  uint64_t target = static_cast<uint64_t>(entry.count * ratio);
+  uint64_t sum = 0;
+  for (int i = 0; i < EXPIRY_PROFILER_HIST_BITS; i++) {
+    sum += entry.hist[i];
+    if (sum > target) {
+      return i ? std::min<uint64_t>((1ULL << i) - 1, entry.max_cycles) : 0;
+    }
+  }
+  return entry.max_cycles;
+}
+
+void ExpiryProfiler::FillStat(const TypeEntry& entry, ExpiryProfileStat* stat) const {
+  stat->name = entry.name;
+  stat->count = entry.count;
+  stat->total_cycles = entry.total_cycles;
+  stat->max_cycles = entry.max_cycles;
+  stat->p99_cycles = Percentile(entry, 0.99);
+  stat->slow_count = entry.slow_count;
+}
+
+void ExpiryProfiler::TopN(int top_n, std::vector<ExpiryProfileStat>* out) const {
+  out->clear();
+  for (int i = 0; i < EXPIRY_PROFILER_TYPES; i++) {
+    if (!types_[i].name || !types_[i].count)
+      continue;
+    ExpiryProfileStat stat;
+    FillStat(types_[i], &stat);
+    out->push_back(stat);
+  }
+  std::sort(out->begin(), out->end(), [](const ExpiryProfileStat& a, const ExpiryProfileStat& b) {
+    return a.total_cycles > b.total_cycles;
+  });
+  if (top_n >= 0 && out->size() > static_cast<size_t>(top_n))
+    out->resize(top_n);
+}
+
+void ExpiryProfiler::SlowRecords(std::vector<ExpirySlowRecord>* out) const {
+  out->clear();
+  uint64_t num = std::min<uint64_t>(slow_log_pos_, EXPIRY_PROFILER_SLOW_LOG);
+  for (uint64_t i = 1; i <= num; i++) {
+    out->push_back(slow_log_[(slow_log_pos_ - i) % EXPIRY_PROFILER_SLOW_LOG]);
+  }
+}
+
+std::string ExpiryProfiler::Report(int top_n) const {
+  std::vector<ExpiryProfileStat> stats;
+  TopN(top_n, &stats);
+  std::string report = format_string("expiry profile(cycles/us:%.1f, slow threshold:%ldus):\n",
+                                     cycles_per_us_, slow_threshold_us_);
+  for (const ExpiryProfileStat& stat : stats) {
+    report += format_string(
+        "  %-40s count:%lu total:%.1fus avg:%.2fus p99:%.2fus max:%.2fus slow:%lu\n", stat.name,
+        stat.count, stat.total_cycles / cycles_per_us_,
+        stat.total_cycles / cycles_per_us_ / stat.count, stat.p99_cycles / cycles_per_us_,
+        stat.max_cycles / cycles_per_us_, stat.slow_count);
+  }
+
+  std::vector<ExpirySlowRecord> slows;
+  SlowRecords(&slows);
+  for (const ExpirySlowRecord& slow : slows) {
+    report += format_string("  slow %-35s timer:%d user_data:%ld jiffies:%ld cost:%.2fus\n",
+                            slow.name, slow.timer_id, slow.user_data, slow.jiffies,
+                            slow.cycles / cycles_per_us_);
+  }
+  if (dropped_types_) {
+    report += format_string("  dropped(type table full):%lu\n", dropped_types_);
+  }
+  return report;
+}
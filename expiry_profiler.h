@@ -0,0 +1,107 @@
+// @brief ExpiryAction回调耗时统计
+// 按action类型(Tag()或RTTI名)聚合OnExpiry的cycle开销, 记录count/total/p99,
+// 超过阈值的慢回调连同user_data一起记下来, 用于定位tick超时是哪个action导致的.
+// 未开启时RunTimers里只多一次bool判断.
+//  @author justinzhu
+//  @date 2026年10月19日14:20:11
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "expiry_action.h"
+#include "singleton.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define EXPIRY_PROFILER_TYPES (256)     // 最多统计的action类型数, 2的幂
+#define EXPIRY_PROFILER_HIST_BITS (64)  // log2直方图桶数
+#define EXPIRY_PROFILER_SLOW_LOG (64)   // 慢回调环形记录条数
+
+// 单个action类型的聚合结果
+struct ExpiryProfileStat {
+  const char* name;       // Tag()或typeid名
+  uint64_t count;         // 回调次数
+  uint64_t total_cycles;  // 总cycle
+  uint64_t max_cycles;    // 最大单次cycle
+  uint64_t p99_cycles;    // p99(log2直方图桶上界, 近似值)
+  uint64_t slow_count;    // 超过阈值的次数
+};
+
+// 一条慢回调记录
+struct ExpirySlowRecord {
+  const char* name;
+  int32_t timer_id;
+  int64_t user_data;
+  int64_t jiffies;
+  uint64_t cycles;
+};
+
+class ExpiryProfiler {
+ public:
+  ExpiryProfiler();
+
+  // 开启时会做一次cycle/us校准(约1ms)
+  void Enable(bool enable);
+  bool Enabled() const { return enabled_; }
+
+  // 慢回调阈值, 单位us, 0表示不记录慢回调
+  void SetSlowThresholdUs(int64_t us);
+  int64_t SlowThresholdUs() const { return slow_threshold_us_; }
+
+  void Reset();
+
+  // 便宜的cycle计数, x86下为rdtsc, 其他平台退化为ns
+  static uint64_t Now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(NowNs());
+#endif
+  }
+
+  // 回调前取名字, 回调内可能会析构action
+  const char* ActionName(ExpiryAction* action);
+  void Record(const char* name, int32_t timer_id, int64_t user_data, int64_t jiffies,
+              uint64_t start);
+
+  // 按total_cycles倒序返回前top_n个类型
+  void TopN(int top_n, std::vector<ExpiryProfileStat>* out) const;
+  // 最近的慢回调, 新的在前
+  void SlowRecords(std::vector<ExpirySlowRecord>* out) const;
+  std::string Report(int top_n) const;
+
+  double CyclesPerUs() const { return cycles_per_us_; }
+
+ private:
+  struct TypeEntry {
+    const char* name;
+    uint64_t count;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+    uint64_t slow_count;
+    uint64_t hist[EXPIRY_PROFILER_HIST_BITS];  // hist[i]: cycles在[2^(i-1), 2^i)
+  };
+
+  static int64_t NowNs();
+  void Calibrate();
+  TypeEntry* FindEntry(const char* name);
+  static uint64_t Percentile(const TypeEntry& entry, double ratio);
+  void FillStat(const TypeEntry& entry, ExpiryProfileStat* stat) const;
+
+ private:
+  bool enabled_;
+  double cycles_per_us_;
+  int64_t slow_threshold_us_;
+  uint64_t slow_threshold_cycles_;
+  uint64_t dropped_types_;  // 类型表满后丢弃的回调数
+  TypeEntry types_[EXPIRY_PROFILER_TYPES];
+  ExpirySlowRecord slow_log_[EXPIRY_PROFILER_SLOW_LOG];
+  uint64_t slow_log_pos_;
+};
+
+// 进程内统计, 不放共享内存
+inline ExpiryProfiler& GetExpiryProfiler() { return Singleton<ExpiryProfiler>::GetInstance(); }
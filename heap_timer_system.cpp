@@ -0,0 +1,275 @@
+#include "heap_timer_system.h"
+#include "expiry_profiler.h"
+#include "lib_log.h"
+#include "lib_time_source.h"
+#include "timer_probe.h"
+#include "linux_like_bitops.h"
+#include "timer_group.h"
+
+IMPLEMENT_IDCREATE_WITHTYPE(HeapTimerSystem, EOT_OBJ_HEAP_TIMER_SYSTEM, CObj)
+
+HeapTimerSystem::HeapTimerSystem() {
+  if (SHM_MODE_INIT == get_shm_mode()) {
+    CreateInit();
+  } else {
+    ResumeInit();
+  }
+}
+
+void HeapTimerSystem::CreateInit() {
+  timer_jiffies_ = 0;
+  expired_timers_ = 0;
+  heap_.Clear();
+  names_.Clear();
+  memset(&spread_, 0, sizeof(spread_));
+  sites_.Clear(0);
+}
+
+HeapTimerSystem::~HeapTimerSystem() {
+  while (!heap_.Empty()) {
+    CIDRuntimeClass::DestroyObj(heap_.Pop());
+  }
+}
+
+int HeapTimerSystem::Init(int64_t jiffies) {
+  timer_jiffies_ = jiffies;
+  sites_.ResetCounters(jiffies);  // 创建位置的速率从Init开始算
+  return 0;
+}
+
+void HeapTimerSystem::RunTimers(int64_t jiffies) {
+  TIMER_PROBE3(run_enter, jiffies, timer_jiffies_, heap_.Size());
+  if (unlikely(run_listener_ != nullptr)) {
+    run_listener_->OnRunTimers(jiffies);
+  }
+  ExpiryProfiler *profiler = GetExpiryProfiler().Enabled() ? &GetExpiryProfiler() : nullptr;
+  timer_jiffies_ = jiffies;
+  while (!heap_.Empty() && heap_.TopExpires() <= jiffies) {
+    Timer *timer = heap_.Pop();
+    expired_timers_++;
+    TIMER_PROBE5(expire, timer->TimerID(), timer->Action(), timer->UserData(), jiffies,
+                 jiffies - timer->Expires());
+    timer->SetFlag(TIMER_FLAG_RUNNING);
+    int64_t next = timer->Fire(jiffies, profiler);
+    timer->ClearFlag(TIMER_FLAG_RUNNING);
+    if (unlikely(timer->Dead())) {
+      // 回调里ClearTimer了自己
+      FreeTimer(timer);
+      continue;
+    }
+    if (unlikely(timer->InHeap())) {
+      // 回调里ResetTimer/TouchTimer重新加入了堆, 忽略返回值
+      continue;
+    }
+    if (unlikely(next != TIMER_RESCHEDULE_REPEAT)) {
+      if (next < 0) {
+        FreeTimer(timer);
+      } else {
+        // next为0时要等下一次RunTimers, 避免在本次循环里反复触发
+        timer->SetExpires(jiffies + (next > 0 ? next : 1));
+        if (heap_.Push(timer) != 0) {
+          LogWarnM(LOGM_SYS, "timer heap full, drop rescheduled timer:%d", timer->TimerID());
+          FreeTimer(timer);
+        }
+      }
+      continue;
+    }
+    if (0 == timer->Interval()) {
+      FreeTimer(timer);
+    } else {
+      timer->SetExpires(timer->Expires() + timer->Interval());
+      if (heap_.Push(timer) != 0) {
+        // 回调里新建的timer占满了堆, 弹出的timer已经不在堆里, 不释放就泄漏了
+        LogWarnM(LOGM_SYS, "timer heap full, drop interval timer:%d", timer->TimerID());
+        FreeTimer(timer);
+      }
+    }
+  }
+  TIMER_PROBE3(run_exit, jiffies, expired_timers_, heap_.Size());
+}
+
+int HeapTimerSystem::SetTimer(ExpiryAction *action, int64_t expires, int64_t interval /* = 0*/,
+                              int64_t user_data /* = 0*/) {
+  Timer *timer = InternalSetTimer(action, expires, interval, user_data, true);
+  return timer ? timer->TimerID() : INVALID_ID;
+}
+
+Timer *HeapTimerSystem::InternalSetTimer(ExpiryAction *action, int64_t expires, int64_t interval,
+                                         int64_t user_data, bool spread) {
+  if (heap_.Full()) {
+    return nullptr;
+  }
+  Timer *timer = dynamic_cast<Timer *>(CIDRuntimeClass::CreateObj(EOT_OBJ_TIMER));
+  if (!timer) {
+    return nullptr;
+  }
+
+  if (expires < 0) {
+    expires = 0;
+  }
+  if (interval < 0) {
+    interval = 0;
+  }
+
+  spread = spread && SpreadExpires(&expires, user_data ? user_data : timer->GetObjectID());
+  timer->Init(action, NowMs() + expires, interval, user_data);
+  timer->SetOwnerID(GetGlobalID());
+  if (unlikely(spread))
+    timer->SetFlag(TIMER_FLAG_SPREAD);
+  if (heap_.Push(timer) != 0) {
+    FreeTimer(timer);
+    return nullptr;
+  }
+  TIMER_PROBE4(set, timer->TimerID(), action, user_data, timer->Expires());
+  if (unlikely(arm_listener_ != nullptr))
+    arm_listener_->OnTimerArmed(timer->Expires());
+  return timer;
+}
+
+int HeapTimerSystem::ClearTimer(int timer_id) {
+  Timer *timer = LookupTimer(timer_id);
+  if (!timer) {
+    return -1;
+  }
+
+  InternalClearTimer(timer);
+  return 0;
+}
+
+int HeapTimerSystem::ResetTimer(int timer_id, ExpiryAction *action, int64_t expires,
+                                int64_t interval /* = 0*/, int64_t user_data /* = 0*/) {
+  Timer *timer = LookupTimer(timer_id);
+  if (!timer) {
+    return -1;
+  }
+
+  return InternalResetTimer(timer, action, expires, interval, user_data, true);
+}
+
+int HeapTimerSystem::InternalResetTimer(Timer *timer, ExpiryAction *action, int64_t expires,
+                                         int64_t interval, int64_t user_data, bool spread) {
+  if (expires < 0) {
+    expires = 0;
+  }
+  if (interval < 0) {
+    interval = 0;
+  }
+
+  if (timer->InHeap()) {
+    heap_.Remove(timer);
+  }
+  if (unlikely(timer->Named()) && action != timer->Action()) {
+    // 具名timer的身份是(action, key), 换了action就不再是原来那个名字, 退出索引
+    names_.Remove(timer);
+  }
+  spread = spread && SpreadExpires(&expires, user_data ? user_data : timer->GetObjectID());
+  timer->Init(action, NowMs() + expires, interval, user_data);
+  if (unlikely(spread))
+    timer->SetFlag(TIMER_FLAG_SPREAD);
+  if (heap_.Push(timer) != 0) {
+    // 回调里重置自己时timer已经弹出堆, 回调里新建的timer可能把堆占满
+    LogWarnM(LOGM_SYS, "timer heap full, drop reset timer:%d", timer->TimerID());
+    InternalClearTimer(timer);
+    return -1;
+  }
+  TIMER_PROBE4(reset, timer->TimerID(), action, user_data, timer->Expires());
+  if (unlikely(arm_listener_ != nullptr))
+    arm_listener_->OnTimerArmed(timer->Expires());
+  return 0;
+}
+
+int HeapTimerSystem::TouchTimer(int timer_id, int64_t expires) {
+  Timer *timer = LookupTimer(timer_id);
+  if (!timer || (!timer->InHeap() && !timer->Running())) {
+    return -1;
+  }
+
+  if (expires < 0) {
+    expires = 0;
+  }
+
+  if (timer->InHeap()) {
+    heap_.Remove(timer);
+  }
+  timer->SetExpires(NowMs() + expires);
+  if (heap_.Push(timer) != 0) {
+    LogWarnM(LOGM_SYS, "timer heap full, drop touched timer:%d", timer->TimerID());
+    InternalClearTimer(timer);
+    return -1;
+  }
+  if (unlikely(arm_listener_ != nullptr))
+    arm_listener_->OnTimerArmed(timer->Expires());
+  return 0;
+}
+
+int HeapTimerSystem::ClearTimerGroup(int32_t group_id) {
+  TimerGroup *group = LookupTimerGroup(group_id);
+  if (!group) {
+    return -1;
+  }
+
+  int cleared = 0;
+  while (Timer *timer = group->First()) {
+    group->Remove(timer);
+    InternalClearTimer(timer);
+    cleared++;
+  }
+  return cleared;
+}
+
+int HeapTimerSystem::SetNamedTimer(ExpiryAction *action, int64_t key, int64_t expires,
+                                   int64_t interval /* = 0*/, int64_t user_data /* = 0*/) {
+  Timer *timer = names_.Find(action, key);
+  if (timer) {
+    if (InternalResetTimer(timer, action, expires, interval, user_data) != 0)
+      return INVALID_ID;
+    return timer->TimerID();
+  }
+
+  if (names_.Full()) {
+    return INVALID_ID;
+  }
+  timer = InternalSetTimer(action, expires, interval, user_data);
+  if (!timer) {
+    return INVALID_ID;
+  }
+  names_.Insert(timer, key);
+  return timer->TimerID();
+}
+
+int HeapTimerSystem::ClearNamedTimer(ExpiryAction *action, int64_t key) {
+  Timer *timer = names_.Find(action, key);
+  if (!timer) {
+    return -1;
+  }
+
+  InternalClearTimer(timer);
+  return 0;
+}
+
+int HeapTimerSystem::FindNamedTimer(ExpiryAction *action, int64_t key) {
+  Timer *timer = names_.Find(action, key);
+  return timer ? timer->TimerID() : INVALID_ID;
+}
+
+void HeapTimerSystem::InternalClearTimer(Timer *timer) {
+  TIMER_PROBE4(clear, timer->TimerID(), timer->Action(), timer->UserData(), timer_jiffies_);
+  OnSiteClear(timer);
+  if (timer->InHeap()) {
+    heap_.Remove(timer);
+  }
+  if (unlikely(timer->Running())) {
+    // 回调里清除自己, 回调返回后由RunTimers回收
+    TimerGroup::Leave(timer);
+    names_.Remove(timer);
+    timer->SetFlag(TIMER_FLAG_DEAD);
+    return;
+  }
+  FreeTimer(timer);
+}
+
+void HeapTimerSystem::FreeTimer(Timer *timer) {
+  OnSiteRelease(timer);
+  names_.Remove(timer);
+  CIDRuntimeClass::DestroyObj(timer);
+}
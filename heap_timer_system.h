@@ -0,0 +1,74 @@
+// @brief 基于4叉堆的TimerSystemInterface实现
+// 只有几百个timer且超时时间分布很散的服务, 时间轮的512个槽头和cascade都是纯开销,
+// 精确的堆更快也更省内存. SetTimer/ClearTimer/ResetTimer/RunTimers的语义与TimerSystem一致,
+// 同一jiffy内按加入顺序触发. 容量固定为HEAP_TIMER_CAPACITY, 满了SetTimer返回INVALID_ID.
+// 回调里重置/推迟自己时timer已经弹出堆, 这时堆满则清除它, ResetTimer/TouchTimer返回-1.
+//  @author justinzhu
+//  @date 2026年10月19日16:31:27
+
+#pragma once
+
+#include "comm_base.h"
+#include "timer.h"
+#include "timer_heap.h"
+#include "timer_name_index.h"
+#include "timer_system_interface.h"
+
+#define HEAP_TIMER_CAPACITY (8192)
+
+class HeapTimerSystem : public CObj, public TimerSystemInterface {
+ public:
+  HeapTimerSystem();
+  virtual ~HeapTimerSystem();
+  virtual const char* ClassName() { return "HeapTimerSystem"; }
+  void CreateInit();
+  void ResumeInit() {}
+
+ public:
+  virtual int32_t SystemID() override { return GetGlobalID(); }
+  virtual int Init(int64_t jiffies) override;
+  virtual void RunTimers(int64_t jiffies) override;
+  virtual int64_t NextExpiry() override { return heap_.Empty() ? -1 : heap_.TopExpires(); }
+
+  // 基类的TimeHelper/内联回调/TimerSite重载, 见TimerSystem
+  using TimerSystemInterface::ResetTimer;
+  using TimerSystemInterface::SetTimer;
+  using TimerSystemInterface::TouchTimer;
+
+  // 参数和返回值同TimerSystem::SetTimer
+  virtual int SetTimer(ExpiryAction* action, int64_t expires, int64_t interval = 0,
+                       int64_t user_data = 0) override;
+  virtual int ClearTimer(int32_t timer_id) override;
+  virtual int ResetTimer(int32_t timer_id, ExpiryAction* action, int64_t expires,
+                         int64_t interval = 0, int64_t user_data = 0) override;
+  // 堆里直接调整位置, O(log n)
+  virtual int TouchTimer(int32_t timer_id, int64_t expires) override;
+  virtual int ClearTimerGroup(int32_t group_id) override;
+  virtual int SetNamedTimer(ExpiryAction* action, int64_t key, int64_t expires,
+                            int64_t interval = 0, int64_t user_data = 0) override;
+  virtual int ClearNamedTimer(ExpiryAction* action, int64_t key) override;
+  virtual int FindNamedTimer(ExpiryAction* action, int64_t key) override;
+
+ public:
+  int64_t AllTimers() { return heap_.Size(); }
+  int64_t NamedTimers() { return names_.Size(); }
+  int64_t ExpiredTimers() { return expired_timers_; }
+
+ private:
+  virtual Timer* InternalSetTimer(ExpiryAction* action, int64_t expires, int64_t interval,
+                                  int64_t user_data, bool spread = false) override;
+  // 堆满时清除timer
+  // @return 0=success, -1=堆满
+  int InternalResetTimer(Timer* timer, ExpiryAction* action, int64_t expires, int64_t interval,
+                         int64_t user_data, bool spread = false);
+  void InternalClearTimer(Timer* timer);
+  void FreeTimer(Timer* timer);
+
+ private:
+  int64_t timer_jiffies_;   // 最近一次RunTimers的jiffies
+  int64_t expired_timers_;  // 累计触发的timer数
+  TimerHeap<HEAP_TIMER_CAPACITY> heap_;
+  TimerNameIndex<HEAP_TIMER_CAPACITY * 2> names_;
+
+  DECLARE_IDCREATE(HeapTimerSystem);
+};
@@ -1,5 +1,9 @@
 
 #include "timer.h"
+#include "expiry_profiler.h"
+#include "lib_log.h"
+#include "linux_like_bitops.h"
+#include "timer_group.h"
 
 IMPLEMENT_IDCREATE_WITHTYPE(Timer, EOT_OBJ_TIMER, CObj)
 
@@ -16,10 +20,78 @@ void Timer::CreateInit() {
   expires_ = 0;
   interval_ = 0;
   user_data_ = 0;
+  heap_index_ = -1;
+  flags_ = 0;
+  deferred_expires_ = 0;
+  group_id_ = INVALID_ID;
+  group_prev_ = INVALID_ID;
+  group_next_ = INVALID_ID;
+  site_id_ = 0;
+  owner_id_ = INVALID_ID;
+  callback_id_ = 0;
+  priority_ = TIMER_PRIORITY_NORMAL;
+  generation_ = 0;
+  epoch_ = 0;
 }
 
+Timer *Timer::FromTimerID(int32_t timer_id, bool encoded) {
+  if (timer_id < 0)
+    return nullptr;
+  uint8_t generation = 0;
+  if (encoded && (timer_id & TIMER_ID_REUSED)) {
+    generation = (timer_id >> TIMER_ID_GENERATION_SHIFT) & TIMER_ID_GENERATION_MAX;
+    timer_id &= TIMER_ID_GLOBALID_MASK;
+  }
+  Timer *timer =
+      dynamic_cast<Timer *>(CIDRuntimeClass::GetObjFromGlobalID(timer_id, EOT_OBJ_TIMER));
+  if (!timer || timer->generation_ != generation)
+    return nullptr;
+  return timer;
+}
+
+// 一次性timer到期或被ClearTimer时自动退出所在的组
+Timer::~Timer() { TimerGroup::Leave(this); }
+
 void Timer::ResumeInit() {
+  // 内联回调的timer没有action, 不能做偏移
+  if (!action_)
+    return;
   char *tmp = reinterpret_cast<char *>(action_);
   tmp += CSharedMem::GetSharedMem()->GetAddrOffset();
   action_ = reinterpret_cast<ExpiryAction *>(tmp);
-}
\ No newline at end of file
+}
+int64_t Timer::Fire(int64_t jiffies, ExpiryProfiler *profiler) {
+  ExpiryAction *action = action_;
+  int64_t data = user_data_;
+  const char *name = nullptr;
+  TimerCallbackFunc func = nullptr;
+  int64_t next = TIMER_RESCHEDULE_REPEAT;
+  if (!action) {
+    if (!callback_id_)
+      return next;
+    func = GetTimerCallbackRegistry().Find(callback_id_, &name);
+    if (unlikely(!func)) {
+      // resume后新进程里没有这个key的回调, payload无法解释, 不触发, 循环timer也不再续期
+      LogWarnM(LOGM_SYS, "timer callback not registered, drop timer:%s", DebugString().c_str());
+      return TIMER_RESCHEDULE_STOP;
+    }
+  }
+
+  int32_t timer_id = TimerID();
+  if (unlikely(profiler != nullptr)) {
+    if (action)
+      name = profiler->ActionName(action);
+    uint64_t start = ExpiryProfiler::Now();
+    if (action) {
+      next = action->OnExpiryReschedule(timer_id, data);
+    } else {
+      func(timer_id, payload_);
+    }
+    profiler->Record(name, timer_id, data, jiffies, start);
+  } else if (action) {
+    next = action->OnExpiryReschedule(timer_id, data);
+  } else {
+    func(timer_id, payload_);
+  }
+  return next;
+}
@@ -12,31 +12,99 @@
 #include "comm_object.h"
 #include "expiry_action.h"
 #include "lib_str.h"
+#include "timer_callback.h"
+#include "timer_cron.h"
 #include "timer_defines.h"
 
+template <int CAPACITY>
+class TimerHeap;
+template <int CAPACITY>
+class TimerNameIndex;
+class ExpiryProfiler;
+class TimerGroup;
+
+// Timer::flags_
+enum TimerFlag {
+  TIMER_FLAG_DEAD = 1 << 0,     // lazy cancel模式下已取消, 等cascade或到期时统一回收
+  TIMER_FLAG_NAMED = 1 << 1,    // 在TimerNameIndex里, key见NameKey()
+  TIMER_FLAG_RUNNING = 1 << 2,  // 正在执行到期回调, 回调里清除自己时只打DEAD标记
+  TIMER_FLAG_CRON = 1 << 3,     // cron timer, payload_里是CronSchedule, 到期后按它重新挂载
+  TIMER_FLAG_LOGIC = 1 << 4,    // SetTimerAt和cron的逻辑时间timer, 时间偏移变化时整体平移
+  TIMER_FLAG_SPREAD = 1 << 5,   // 按打散策略推迟过, cascade时可以顺延到别的槽
+};
+
+// 到期分发的优先级, 见TimerSystem::SetTimerPriority
+enum TimerPriority {
+  TIMER_PRIORITY_HIGH = 0,    // 战斗/网络等关键timer, 同一jiffy里最先触发, 不会被预算推迟
+  TIMER_PRIORITY_NORMAL = 1,  // 默认
+  TIMER_PRIORITY_LOW = 2,     // 表现类timer, 最后触发, 超出预算时最先被推迟
+  TIMER_PRIORITY_CLASSES = 3,
+};
+
 // Timer定义
 // @CObj 共享内存存储，可恢复
 // @ListHead<Timer> Timer同时是个链表节点
 class Timer : public CObj, public ListHead<Timer> {
  public:
   Timer();
-  virtual ~Timer() = default;
+  virtual ~Timer();
   std::string DebugString() {
     // https://stackoverflow.com/questions/18039723/c-trying-to-get-function-address-from-a-stdfunction
     return format_string(
-        "(globalid:%d, self:%d, prev:%d, next:%d action:%p, expires:%ld, interval:%ld, "
-        "user_data:%ld)",
-        GetGlobalID(), Self(), Prev(), Next(), reinterpret_cast<void *>(action_), expires_,
-        interval_, user_data_);
+        "(globalid:%d, generation:%u, self:%d, prev:%d, next:%d action:%p, expires:%ld, "
+        "interval:%ld, user_data:%ld, heap_index:%d, flags:%u, deferred_expires:%ld, group:%d)",
+        GetGlobalID(), generation_, Self(), Prev(), Next(), reinterpret_cast<void *>(action_),
+        expires_, interval_, user_data_, heap_index_, flags_, deferred_expires_, group_id_);
+  }
+
+  // SetTimer等返回和回调收到的timer id, 见TIMER_ID_REUSED
+  int32_t TimerID() {
+    if (!generation_)
+      return GetGlobalID();
+    return TIMER_ID_REUSED | (generation_ << TIMER_ID_GENERATION_SHIFT) | GetGlobalID();
   }
+  // 按timer id取对象, 对象已经销毁或者被slab复用过时返回nullptr. 不检查DEAD和所属系统,
+  // 一般用TimerSystemInterface::GetTimer
+  // @encoded 所属系统开过slab时为true, 按TIMER_ID_REUSED解码; 否则id就是globalid
+  static Timer *FromTimerID(int32_t timer_id, bool encoded);
 
   int64_t Expires() { return expires_; }
+  // TouchTimer之后真正的超时时间点, Expires()仍是时间轮里所在槽的时间
+  int64_t Deadline() { return deferred_expires_ > expires_ ? deferred_expires_ : expires_; }
   int64_t Interval() { return interval_; }
   ExpiryAction *Action() { return action_; }
   int64_t UserData() { return user_data_; }
+  bool Dead() { return flags_ & TIMER_FLAG_DEAD; }
+  // 所在TimerGroup的obj_id, -1表示不在组里
+  int32_t GroupID() { return group_id_; }
+  // 创建它的timer系统的globalid, 见TimerSystemInterface::SystemID
+  int32_t OwnerID() { return owner_id_; }
+  bool Named() { return flags_ & TIMER_FLAG_NAMED; }
+  bool Running() { return flags_ & TIMER_FLAG_RUNNING; }
+  // SetNamedTimer的key, 只在Named()时有效
+  int64_t NameKey() { return *reinterpret_cast<const int64_t *>(payload_); }
+  // 内联回调的类型id, 0表示用action_
+  uint32_t CallbackID() { return callback_id_; }
+  bool Cron() { return flags_ & TIMER_FLAG_CRON; }
+  bool LogicTime() { return flags_ & TIMER_FLAG_LOGIC; }
+  bool Spread() { return flags_ & TIMER_FLAG_SPREAD; }
+  TimerPriority Priority() { return static_cast<TimerPriority>(priority_); }
+  // 创建时TimerSystem的epoch, 和当前epoch不同说明已经被ClearAll作废
+  uint16_t Epoch() { return epoch_; }
+  // 被slab复用的次数, 见TIMER_ID_REUSED
+  uint8_t Generation() { return generation_; }
+  // 创建位置的id, 见TimerSite, 0表示没有记录. Init不会改它, ResetTimer后仍算原来的位置
+  uint32_t SiteID() { return site_id_; }
 
  protected:
   friend class TimerSystem;
+  friend class HeapTimerSystem;
+  template <int CAPACITY>
+  friend class TimerHeap;
+  friend class TimerGroup;
+  friend class TimerSystemInterface;
+  template <int CAPACITY>
+  friend class TimerNameIndex;
   // 初始化Timer函数
   // @param expires 超时时间点
   // @param interval 循环型间隔时间
@@ -46,6 +114,10 @@ class Timer : public CObj, public ListHead<Timer> {
     expires_ = expires;
     interval_ = interval;
     user_data_ = user_data;
+    flags_ &= TIMER_FLAG_NAMED | TIMER_FLAG_RUNNING;  // ResetTimer后仍在索引里
+    deferred_expires_ = 0;
+    if (action)
+      callback_id_ = 0;  // 重新指定了action, 内联回调失效
     SetNext(LIST_POISON);
   }
 
@@ -53,10 +125,47 @@ class Timer : public CObj, public ListHead<Timer> {
   void SetInterval(int64_t interval) { interval_ = interval; }
   void SetAction(ExpiryAction *action) { action_ = action; }
   void SetUserData(int64_t user_data) { user_data_ = user_data; }
+  int64_t DeferredExpires() { return deferred_expires_; }
+  void SetDeferredExpires(int64_t expires) { deferred_expires_ = expires; }
+  // 把回调对象拷进payload_, 调用方保证F满足InlineTimerCallback的要求
+  template <typename F>
+  void SetCallback(const F &callback) {
+    memcpy(payload_, &callback, sizeof(F));
+    callback_id_ = InlineTimerCallback<F>::Id();
+  }
+  // cron timer的action_不为空, 不会用到内联回调, payload_借给CronSchedule
+  void SetCron(const CronSchedule &schedule) {
+    static_assert(sizeof(CronSchedule) <= TIMER_INLINE_PAYLOAD_SIZE, "payload too small");
+    memcpy(payload_, &schedule, sizeof(schedule));
+    flags_ |= TIMER_FLAG_CRON;
+  }
+  const CronSchedule &GetCron() { return *reinterpret_cast<const CronSchedule *>(payload_); }
+  // 具名timer只由SetNamedTimer用action创建, 不会是内联回调/cron/逻辑时间timer, key借payload_
+  // 开头的8字节, 不单独占字段
+  void SetNameKey(int64_t key) { *reinterpret_cast<int64_t *>(payload_) = key; }
+  // 逻辑时间timer链表(见TimerSystem::logic_list_)的前后节点, 存obj_id. 逻辑时间timer都有
+  // action_, 不用内联回调, 借payload_末尾的8字节, 在CronSchedule后面, 不增加Timer的大小
+  int32_t *LogicLinks() {
+    static_assert(sizeof(CronSchedule) + 2 * sizeof(int32_t) <= TIMER_INLINE_PAYLOAD_SIZE,
+                  "payload too small");
+    return reinterpret_cast<int32_t *>(payload_ + TIMER_INLINE_PAYLOAD_SIZE - 2 * sizeof(int32_t));
+  }
+  void SetPriority(TimerPriority priority) { priority_ = static_cast<uint8_t>(priority); }
+  void SetEpoch(uint16_t epoch) { epoch_ = epoch; }
+  void SetGeneration(uint8_t generation) { generation_ = generation; }
+  void SetOwnerID(int32_t owner_id) { owner_id_ = owner_id; }
+  void SetSiteID(uint32_t site_id) { site_id_ = site_id; }
+  void SetFlag(uint32_t flag) { flags_ |= flag; }
+  void ClearFlag(uint32_t flag) { flags_ &= ~flag; }
 
   void CreateInit();
   void ResumeInit();
 
+  // 到期时调用action_->OnExpiryReschedule或内联回调, profiler非空时统计耗时
+  // @return 见ExpiryAction::OnExpiryReschedule, 内联回调总是TIMER_RESCHEDULE_REPEAT,
+  // 回调id在本进程没有注册时返回TIMER_RESCHEDULE_STOP
+  int64_t Fire(int64_t jiffies, ExpiryProfiler *profiler);
+
  protected:
   // 将Timer从链表里移除
   void DetachTimer(bool clear_pending) {
@@ -69,11 +178,27 @@ class Timer : public CObj, public ListHead<Timer> {
   // 判断timer是不是已经在列表里
   bool TimerPending() { return Next() >= 0; }
 
+  // 判断timer是不是在TimerHeap里
+  bool InHeap() { return heap_index_ >= 0; }
+
  private:
-  int64_t expires_;       // 超时时间点
-  int64_t interval_;      // 循环型的间隔时间
-  ExpiryAction *action_;  // 调用者的this指针
-  int64_t user_data_;     // 用户数据
+  int64_t expires_;           // 超时时间点
+  int64_t interval_;          // 循环型的间隔时间
+  ExpiryAction *action_;      // 调用者的this指针
+  int64_t user_data_;         // 用户数据
+  int32_t heap_index_;        // 在TimerHeap中的下标, -1表示不在堆里
+  uint32_t flags_;            // TimerFlag
+  int64_t deferred_expires_;  // TouchTimer推迟后的超时时间点, 到达旧槽时按它重新挂载
+  int32_t group_id_;          // 所在TimerGroup的obj_id, Init不会改它, ResetTimer后仍在组里
+  int32_t group_prev_;        // 组内链表, 存obj_id
+  int32_t group_next_;
+  uint32_t site_id_;          // 创建位置, 见timer_site.h, 0表示没有记录
+  int32_t owner_id_;          // 所属timer系统的globalid, 组和Clear/Reset/Touch按它拒绝别的系统
+  uint32_t callback_id_;      // 内联回调类型id, 见TimerCallbackRegistry
+  uint8_t priority_;          // TimerPriority, Init不会改它
+  uint8_t generation_;        // 被slab复用的次数, 和epoch_一起放在对齐空隙里
+  uint16_t epoch_;            // 见TimerSystem::ClearAll, 放在对齐空隙里不增加大小
+  alignas(8) char payload_[TIMER_INLINE_PAYLOAD_SIZE];  // 内联回调对象
 
   DECLARE_IDCREATE(Timer);
 };
@@ -0,0 +1,136 @@
+#include "timer_arena.h"
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "lib_log.h"
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+
+#define TIMER_ARENA_MAX_NODES (1024)
+
+namespace {
+
+uintptr_t AlignDown(uintptr_t addr, uintptr_t align) { return addr & ~(align - 1); }
+uintptr_t AlignUp(uintptr_t addr, uintptr_t align) { return (addr + align - 1) & ~(align - 1); }
+
+int ResolveNode(int node) {
+  return node == TIMER_ARENA_LOCAL_NODE ? TimerArenaCurrentNode() : node;
+}
+
+// 把[addr, addr+size)覆盖的页绑定到node, 已经分配的页迁移过去
+// @return 绑定的节点, 失败返回TIMER_ARENA_NO_NODE
+int BindNode(void* addr, size_t size, int node) {
+  node = ResolveNode(node);
+  if (node < 0 || node >= TIMER_ARENA_MAX_NODES)
+    return TIMER_ARENA_NO_NODE;
+  uintptr_t page = static_cast<uintptr_t>(getpagesize());
+  uintptr_t begin = AlignDown(reinterpret_cast<uintptr_t>(addr), page);
+  uintptr_t end = AlignUp(reinterpret_cast<uintptr_t>(addr) + size, page);
+  unsigned long mask[TIMER_ARENA_MAX_NODES / (8 * sizeof(unsigned long))];
+  memset(mask, 0, sizeof(mask));
+  mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+  if (syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED, mask, TIMER_ARENA_MAX_NODES,
+              MPOL_MF_MOVE) != 0) {
+    LogWarnM(LOGM_SYS, "timer arena mbind failed, node:%d errno:%d", node, errno);
+    return TIMER_ARENA_NO_NODE;
+  }
+  return node;
+}
+
+}  // namespace
+
+int TimerArenaCurrentNode() {
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+    return 0;
+  return static_cast<int>(node);
+}
+
+int TimerArenaAdvise(const TimerArenaRange* ranges, int count, const TimerArenaOptions& options,
+                     TimerArenaResult* result) {
+  result->page = TIMER_ARENA_PAGE_NORMAL;
+  result->numa_node = TIMER_ARENA_NO_NODE;
+  result->huge_bytes = 0;
+  if (!ranges || count <= 0)
+    return -1;
+  int node = ResolveNode(options.numa_node);
+  bool bind = options.numa_node != TIMER_ARENA_NO_NODE;
+  bool collapse_failed = false;
+  for (int i = 0; i < count; i++) {
+    void* addr = reinterpret_cast<void*>(ranges[i].begin);
+    size_t size = ranges[i].end - ranges[i].begin;
+    // 先绑定节点, 之后合并出来的大页就分配在这个节点上
+    if (bind) {
+      result->numa_node = BindNode(addr, size, node);
+      // 失败一次后不再绑定后面的区间, 免得每个区间都告警
+      bind = result->numa_node != TIMER_ARENA_NO_NODE;
+    }
+    if (!options.huge_pages)
+      continue;
+    uintptr_t begin = AlignUp(ranges[i].begin, TIMER_ARENA_HUGE_PAGE_SIZE);
+    uintptr_t end = AlignDown(ranges[i].end, TIMER_ARENA_HUGE_PAGE_SIZE);
+    if (begin >= end ||
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE) != 0)
+      continue;
+    result->page = TIMER_ARENA_PAGE_THP;
+    // 已经分配的页khugepaged要很久才会合并, 6.1以后的内核可以同步合并, 失败不影响使用
+    if (madvise(reinterpret_cast<void*>(begin), end - begin, MADV_COLLAPSE) != 0 &&
+        errno != EINVAL && !collapse_failed) {
+      LogWarnM(LOGM_SYS, "timer arena collapse failed, errno:%d", errno);
+      collapse_failed = true;
+    }
+  }
+  result->huge_bytes = TimerArenaHugeBytes(reinterpret_cast<void*>(ranges[0].begin),
+                                           ranges[count - 1].end - ranges[0].begin);
+  return 0;
+}
+
+int TimerArenaAdvise(void* addr, size_t size, const TimerArenaOptions& options,
+                     TimerArenaResult* result) {
+  if (!addr || !size) {
+    result->page = TIMER_ARENA_PAGE_NORMAL;
+    result->numa_node = TIMER_ARENA_NO_NODE;
+    result->huge_bytes = 0;
+    return -1;
+  }
+  TimerArenaRange range;
+  range.begin = reinterpret_cast<uintptr_t>(addr);
+  range.end = range.begin + size;
+  return TimerArenaAdvise(&range, 1, options, result);
+}
+
+int64_t TimerArenaHugeBytes(void* addr, size_t size) {
+  FILE* fp = fopen("/proc/self/smaps", "r");
+  if (!fp)
+    return -1;
+  uintptr_t begin = reinterpret_cast<uintptr_t>(addr);
+  uintptr_t end = begin + size;
+  bool overlap = false;
+  int64_t kb = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), fp)) {
+    unsigned long start, stop;
+    // 映射的首行是"起始-结束 权限 ...", 字段行不会匹配两个数
+    if (sscanf(line, "%lx-%lx ", &start, &stop) == 2) {
+      overlap = start < end && stop > begin;
+      continue;
+    }
+    if (!overlap)
+      continue;
+    if (strncmp(line, "AnonHugePages:", 14) == 0) {
+      kb += strtoll(line + 14, nullptr, 10);
+    } else if (strncmp(line, "ShmemPmdMapped:", 15) == 0) {
+      kb += strtoll(line + 15, nullptr, 10);
+    }
+  }
+  fclose(fp);
+  return kb * 1024;
+}
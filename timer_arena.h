@@ -0,0 +1,56 @@
+// @brief timer存储区域的大页和NUMA策略
+// 几千万个Timer铺在共享内存里时, Cascade和RunTimers沿链表跳转基本每步一次TLB miss.
+// 用2MB大页后同样的内存只需要1/512的TLB项. Timer由comm库的对象池分配, 这里不创建存储,
+// 只对对象池里timer所在的内存建议透明大页并同步合并(MADV_COLLAPSE), 可以同时绑定到某个
+// NUMA节点, 一般是跑RunTimers的线程所在的节点. 见TimerSystem::BindTimerArena.
+// 只用系统调用, 不依赖libnuma. 内核不支持的步骤跳过, 结果见TimerArenaResult.
+//  @author justinzhu
+//  @date 2026年10月21日14:08:31
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIMER_ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define TIMER_ARENA_NO_NODE (-1)     // 不绑定NUMA节点
+#define TIMER_ARENA_LOCAL_NODE (-2)  // 调用线程当前所在的节点
+
+struct TimerArenaOptions {
+  bool huge_pages;  // 是否使用大页
+  int numa_node;    // 节点号, 或TIMER_ARENA_NO_NODE/TIMER_ARENA_LOCAL_NODE
+};
+
+enum TimerArenaPage {
+  TIMER_ARENA_PAGE_NORMAL = 0,  // 普通4KB页
+  TIMER_ARENA_PAGE_THP = 1,     // 建议了透明大页, 实际大页数见TimerArenaResult::huge_bytes
+};
+
+// 地址区间[begin, end)
+struct TimerArenaRange {
+  uintptr_t begin;
+  uintptr_t end;
+};
+
+struct TimerArenaResult {
+  int page;            // TimerArenaPage
+  int numa_node;       // 绑定到的节点, TIMER_ARENA_NO_NODE表示没有绑定
+  int64_t huge_bytes;  // 区域内已经是大页的字节数, 读不到/proc/self/smaps时为-1
+};
+
+// 调用线程当前所在的NUMA节点, 取不到时返回0
+int TimerArenaCurrentNode();
+
+// 对若干按地址升序, 互不相交的区间应用策略, 区间之间的内存不受影响.
+// NUMA绑定区间覆盖的每一页(已经分配的页迁移过去), 大页只处理区间内按2MB对齐的部分.
+// 有一个区间绑定失败时numa_node为TIMER_ARENA_NO_NODE
+// @return 0=success, <0=没有区间
+int TimerArenaAdvise(const TimerArenaRange* ranges, int count, const TimerArenaOptions& options,
+                     TimerArenaResult* result);
+// 单个区间[addr, addr+size)
+int TimerArenaAdvise(void* addr, size_t size, const TimerArenaOptions& options,
+                     TimerArenaResult* result);
+
+// /proc/self/smaps里[addr, addr+size)覆盖的映射中AnonHugePages+ShmemPmdMapped的字节数
+// @return 读取失败返回-1
+int64_t TimerArenaHugeBytes(void* addr, size_t size);
@@ -0,0 +1,383 @@
+// @brief TimerSystem性能基准
+// 覆盖SetTimer/ClearTimer/ResetTimer/ModTimer/RunTimers, live timer数从1k到10M.
+// workload:
+//   uniform   均匀分布的短超时, 顺带测ResetTimer/ModTimer
+//   request   指数分布的请求超时, 95%在超时前被ClearTimer
+//   periodic  长期存在的循环timer
+//   burst     大量timer在同一个jiffy超时
+//   idle      idle/keepalive timer被反复续期, 对比TouchTimer和ResetTimer
+// 输出每种操作的ns/op, 每个op平均被Cascade搬运的次数, 以及RSS.
+// --engine heap时测HeapTimerSystem, 配合--factor 2可以看出和时间轮的交叉点.
+// --lazy 1时时间轮开启lazy cancel, 主要看request的ClearTimer.
+// 对象池和共享内存由comm库初始化, EOT_OBJ_TIMER的容量需要不小于--max.
+// --hugepage 1 / --numa node|local 时时间轮先ReserveTimers(n)再BindTimerArena, 对比tick耗时;
+// 预留本身就省掉了SetTimer的分配, 对比页大小的影响时基线用--reserve 1 --hugepage 0;
+// --tlb 1 时用perf_event_open统计RunTimers期间用户态的dTLB读miss, 虚拟机里常常没有这个计数器.
+//
+// usage: timer_bench [--engine wheel|heap]
+//                    [--workload uniform|request|periodic|burst|idle|all]
+//                    [--min N] [--max N] [--factor F] [--lazy 0|1]
+//                    [--reserve 0|1] [--hugepage 0|1] [--numa -1|N|local] [--tlb 0|1]
+//  @author justinzhu
+//  @date 2026年10月19日15:02:37
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "clock.h"
+#include "heap_timer_system.h"
+#include "lib_time_source.h"
+#include "timer_system.h"
+
+namespace {
+
+class BenchAction : public ExpiryAction {
+ public:
+  void OnExpiry(int32_t timer_globalid, int64_t user_data) override { fired_++; }
+  int64_t fired_ = 0;
+};
+
+struct BenchEnv {
+  TimerSystemInterface* timers;
+  TimerSystem* wheel;  // 时间轮engine才有, 用于ModTimer和cascade统计
+  BenchAction action;
+  int64_t now;  // 当前jiffies(ms)
+  std::mt19937_64 rng;
+  int tlb_fd;          // dTLB miss计数器, -1表示不统计
+  int64_t tlb_misses;  // 最近一次RunUntilFired的miss数, -1表示没有
+};
+
+// 本线程用户态的dTLB读miss计数器, 创建时处于关闭状态
+// @return 不支持时返回-1
+int OpenTlbCounter() {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+// 把全局时间源推进到ms, SetTimer等接口都以GetRealTickTimeMs()为基准
+void SetNow(BenchEnv* env, int64_t ms) {
+  struct timeval tv;
+  tv.tv_sec = ms / 1000;
+  tv.tv_usec = (ms % 1000) * 1000;
+  GetTimeSource().UpdateTime(&tv);
+  env->now = ms;
+}
+
+int64_t RssKb() {
+  FILE* fp = fopen("/proc/self/status", "r");
+  if (!fp)
+    return 0;
+  char line[256];
+  int64_t rss = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    if (strncmp(line, "VmRSS:", 6) == 0) {
+      rss = strtoll(line + 6, nullptr, 10);
+      break;
+    }
+  }
+  fclose(fp);
+  return rss;
+}
+
+void Report(const char* workload, int64_t n, const char* op, int64_t ops, int64_t ns,
+            BenchEnv* env) {
+  TimerStats stats;
+  memset(&stats, 0, sizeof(stats));
+  if (env->wheel) {
+    stats = env->wheel->Stats();
+    env->wheel->ResetStats();
+  }
+  printf("%-9s %10ld %-10s %10ld ops %10.1f ns/op %8.3f cascade/op %8ld cascades %8ld MB\n",
+         workload, n, op, ops, ops ? static_cast<double>(ns) / ops : 0.0,
+         ops ? static_cast<double>(stats.cascaded_timers) / ops : 0.0, stats.cascades,
+         RssKb() / 1024);
+  if (env->tlb_misses >= 0) {
+    printf("%-9s %10ld %-10s %10.3f dtlb-miss/op\n", workload, n, op,
+           ops ? static_cast<double>(env->tlb_misses) / ops : 0.0);
+    env->tlb_misses = -1;
+  }
+}
+
+// 逐jiffy推进直到action累计触发target次, 返回RunTimers总耗时
+int64_t RunUntilFired(BenchEnv* env, int64_t target, int64_t max_jiffies, int64_t* max_tick_ns) {
+  int64_t total = 0;
+  int64_t end = env->now + max_jiffies;
+  if (env->tlb_fd >= 0)
+    ioctl(env->tlb_fd, PERF_EVENT_IOC_RESET, 0);
+  while (env->action.fired_ < target && env->now < end) {
+    SetNow(env, env->now + 1);
+    if (env->tlb_fd >= 0)
+      ioctl(env->tlb_fd, PERF_EVENT_IOC_ENABLE, 0);
+    int64_t start = Clock::GetNowTickCount();
+    env->timers->RunTimers(env->now);
+    int64_t cost = Clock::GetNowTickCount() - start;
+    if (env->tlb_fd >= 0)
+      ioctl(env->tlb_fd, PERF_EVENT_IOC_DISABLE, 0);
+    total += cost;
+    if (max_tick_ns && cost > *max_tick_ns)
+      *max_tick_ns = cost;
+  }
+  int64_t misses = 0;
+  if (env->tlb_fd >= 0 && read(env->tlb_fd, &misses, sizeof(misses)) == sizeof(misses))
+    env->tlb_misses = misses;
+  return total;
+}
+
+void BenchUniform(BenchEnv* env, int64_t n) {
+  std::uniform_int_distribution<int64_t> dist(1, 1000);
+  std::vector<int32_t> ids(n);
+  env->action.fired_ = 0;
+
+  int64_t start = Clock::GetNowTickCount();
+  for (int64_t i = 0; i < n; i++) {
+    ids[i] = env->timers->SetTimer(&env->action, dist(env->rng), 0, i);
+  }
+  Report("uniform", n, "SetTimer", n, Clock::GetNowTickCount() - start, env);
+
+  start = Clock::GetNowTickCount();
+  for (int64_t i = 0; i < n; i++) {
+    env->timers->ResetTimer(ids[i], &env->action, dist(env->rng), 0, i);
+  }
+  Report("uniform", n, "ResetTimer", n, Clock::GetNowTickCount() - start, env);
+
+  if (env->wheel) {
+    std::vector<Timer*> timer_list(n);
+    for (int64_t i = 0; i < n; i++) {
+      timer_list[i] = env->timers->GetTimer(ids[i]);
+    }
+    start = Clock::GetNowTickCount();
+    for (int64_t i = 0; i < n; i++) {
+      env->wheel->ModTimer(timer_list[i], env->now, env->now + dist(env->rng));
+    }
+    Report("uniform", n, "ModTimer", n, Clock::GetNowTickCount() - start, env);
+  }
+
+  int64_t cost = RunUntilFired(env, n, 2000, nullptr);
+  Report("uniform", n, "RunTimers", env->action.fired_, cost, env);
+}
+
+void BenchRequest(BenchEnv* env, int64_t n) {
+  std::exponential_distribution<double> dist(1.0 / 2000);  // 平均2s
+  std::vector<int32_t> ids(n);
+  env->action.fired_ = 0;
+
+  int64_t start = Clock::GetNowTickCount();
+  for (int64_t i = 0; i < n; i++) {
+    ids[i] = env->timers->SetTimer(&env->action, 1 + static_cast<int64_t>(dist(env->rng)), 0, i);
+  }
+  Report("request", n, "SetTimer", n, Clock::GetNowTickCount() - start, env);
+
+  // 95%的请求在超时前返回
+  int64_t cleared = 0;
+  start = Clock::GetNowTickCount();
+  for (int64_t i = 0; i < n; i++) {
+    if (i % 20 != 0) {
+      env->timers->ClearTimer(ids[i]);
+      cleared++;
+    }
+  }
+  Report("request", n, "ClearTimer", cleared, Clock::GetNowTickCount() - start, env);
+  if (env->wheel && env->wheel->LazyCancel()) {
+    printf("%-9s %10ld dead timers %ld, %ld KB\n", "request", n, env->wheel->DeadTimers(),
+           env->wheel->DeadTimerBytes() / 1024);
+  }
+
+  int64_t cost = RunUntilFired(env, n - cleared, 120000, nullptr);
+  Report("request", n, "RunTimers", env->action.fired_, cost, env);
+}
+
+void BenchPeriodic(BenchEnv* env, int64_t n) {
+  const int64_t interval = 1000;
+  const int64_t duration = 10000;
+  std::uniform_int_distribution<int64_t> dist(0, interval - 1);
+  std::vector<int32_t> ids(n);
+  env->action.fired_ = 0;
+
+  int64_t start = Clock::GetNowTickCount();
+  for (int64_t i = 0; i < n; i++) {
+    ids[i] = env->timers->SetTimer(&env->action, dist(env->rng), interval, i);
+  }
+  Report("periodic", n, "SetTimer", n, Clock::GetNowTickCount() - start, env);
+
+  int64_t cost = RunUntilFired(env, INT64_MAX, duration, nullptr);
+  Report("periodic", n, "RunTimers", env->action.fired_, cost, env);
+
+  start = Clock::GetNowTickCount();
+  for (int64_t i = 0; i < n; i++) {
+    env->timers->ClearTimer(ids[i]);
+  }
+  Report("periodic", n, "ClearTimer", n, Clock::GetNowTickCount() - start, env);
+}
+
+void BenchBurst(BenchEnv* env, int64_t n) {
+  env->action.fired_ = 0;
+
+  // 超过tv1的范围, 触发前要经过一次cascade
+  int64_t start = Clock::GetNowTickCount();
+  for (int64_t i = 0; i < n; i++) {
+    env->timers->SetTimer(&env->action, 1000, 0, i);
+  }
+  Report("burst", n, "SetTimer", n, Clock::GetNowTickCount() - start, env);
+
+  int64_t max_tick = 0;
+  int64_t cost = RunUntilFired(env, n, 2000, &max_tick);
+  Report("burst", n, "RunTimers", env->action.fired_, cost, env);
+  printf("%-9s %10ld max tick %.3f ms\n", "burst", n, max_tick / 1e6);
+}
+
+void BenchIdle(BenchEnv* env, int64_t n) {
+  const int64_t timeout = 30000;
+  const int rounds = 10;
+  std::vector<int32_t> ids(n);
+  env->action.fired_ = 0;
+
+  int64_t cost = Clock::GetNowTickCount();
+  for (int64_t i = 0; i < n; i++) {
+    ids[i] = env->timers->SetTimer(&env->action, timeout, 0, i);
+  }
+  Report("idle", n, "SetTimer", n, Clock::GetNowTickCount() - cost, env);
+
+  cost = 0;
+  for (int r = 0; r < rounds; r++) {
+    SetNow(env, env->now + 1);
+    int64_t start = Clock::GetNowTickCount();
+    for (int64_t i = 0; i < n; i++) {
+      env->timers->TouchTimer(ids[i], timeout);
+    }
+    cost += Clock::GetNowTickCount() - start;
+    env->timers->RunTimers(env->now);
+  }
+  Report("idle", n, "TouchTimer", n * rounds, cost, env);
+
+  cost = 0;
+  for (int r = 0; r < rounds; r++) {
+    SetNow(env, env->now + 1);
+    int64_t start = Clock::GetNowTickCount();
+    for (int64_t i = 0; i < n; i++) {
+      env->timers->ResetTimer(ids[i], &env->action, timeout, 0, i);
+    }
+    cost += Clock::GetNowTickCount() - start;
+    env->timers->RunTimers(env->now);
+  }
+  Report("idle", n, "ResetTimer", n * rounds, cost, env);
+
+  for (int64_t i = 0; i < n; i++) {
+    env->timers->ClearTimer(ids[i]);
+  }
+  env->timers->RunTimers(env->now);
+}
+
+struct Workload {
+  const char* name;
+  void (*run)(BenchEnv* env, int64_t n);
+};
+
+const Workload kWorkloads[] = {
+    {"uniform", BenchUniform},
+    {"request", BenchRequest},
+    {"periodic", BenchPeriodic},
+    {"burst", BenchBurst},
+    {"idle", BenchIdle},
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string workload = "all";
+  TimerBackend backend = TIMER_BACKEND_WHEEL;
+  int64_t min_n = 1000;
+  int64_t max_n = 10000000;
+  int64_t factor = 10;
+  bool lazy = false;
+  TimerArenaOptions arena;
+  arena.huge_pages = false;
+  arena.numa_node = TIMER_ARENA_NO_NODE;
+  bool tlb = false;
+  bool reserve = false;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--engine") == 0) {
+      backend = strcmp(argv[i + 1], "heap") == 0 ? TIMER_BACKEND_HEAP : TIMER_BACKEND_WHEEL;
+    } else if (strcmp(argv[i], "--lazy") == 0) {
+      lazy = atoi(argv[i + 1]) != 0;
+    } else if (strcmp(argv[i], "--factor") == 0) {
+      factor = strtoll(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--workload") == 0) {
+      workload = argv[i + 1];
+    } else if (strcmp(argv[i], "--min") == 0) {
+      min_n = strtoll(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--max") == 0) {
+      max_n = strtoll(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--hugepage") == 0) {
+      arena.huge_pages = atoi(argv[i + 1]) != 0;
+    } else if (strcmp(argv[i], "--numa") == 0) {
+      arena.numa_node =
+          strcmp(argv[i + 1], "local") == 0 ? TIMER_ARENA_LOCAL_NODE : atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--reserve") == 0) {
+      reserve = atoi(argv[i + 1]) != 0;
+    } else if (strcmp(argv[i], "--tlb") == 0) {
+      tlb = atoi(argv[i + 1]) != 0;
+    } else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (factor < 2)
+    factor = 2;
+  int tlb_fd = tlb ? OpenTlbCounter() : -1;
+  if (tlb && tlb_fd < 0)
+    printf("dtlb miss counter unavailable, errno:%d\n", errno);
+
+  for (const Workload& w : kWorkloads) {
+    if (workload != "all" && workload != w.name)
+      continue;
+    for (int64_t n = min_n; n <= max_n; n *= factor) {
+      if (backend == TIMER_BACKEND_HEAP && n > HEAP_TIMER_CAPACITY) {
+        printf("%-9s %10ld skipped, heap capacity %d\n", w.name, n, HEAP_TIMER_CAPACITY);
+        break;
+      }
+      BenchEnv env;
+      env.rng.seed(20221028);
+      GetTimeSource().UpdateTime();
+      env.now = GetRealTickTimeMs();
+      env.timers = CreateTimerSystem(backend, env.now);
+      env.wheel = dynamic_cast<TimerSystem*>(env.timers);
+      env.tlb_fd = tlb_fd;
+      env.tlb_misses = -1;
+      if (env.wheel)
+        env.wheel->SetLazyCancel(lazy);
+      bool bind = arena.huge_pages || arena.numa_node != TIMER_ARENA_NO_NODE;
+      if (env.wheel && (reserve || bind)) {
+        int64_t shortfall = env.wheel->ReserveTimers(n);
+        if (shortfall > 0)
+          printf("%-9s %10ld reserve short by %ld\n", w.name, n, shortfall);
+      }
+      if (env.wheel && bind) {
+        TimerArenaResult result;
+        if (env.wheel->BindTimerArena(arena, &result) == 0)
+          printf("%-9s %10ld arena page:%d node:%d huge:%ld MB\n", w.name, n, result.page,
+                 result.numa_node, result.huge_bytes / (1024 * 1024));
+      }
+      w.run(&env, n);
+      CIDRuntimeClass::DestroyObj(dynamic_cast<CObj*>(env.timers));
+    }
+  }
+  if (tlb_fd >= 0)
+    close(tlb_fd);
+  return 0;
+}
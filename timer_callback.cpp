@@ -0,0 +1,58 @@
+#include "timer_callback.h"
+#include <stdlib.h>
+#include <string.h>
+#include "lib_log.h"
+
+TimerCallbackRegistry::TimerCallbackRegistry() {
+  memset(entries_, 0, sizeof(entries_));
+  size_ = 0;
+}
+
+uint32_t TimerCallbackRegistry::Register(const char* name, TimerCallbackFunc func) {
+  // FNV-1a, key由调用方给出, 换了二进制也不变
+  uint32_t id = 2166136261u;
+  for (const char* p = name; *p; p++) {
+    id = (id ^ static_cast<uint8_t>(*p)) * 16777619u;
+  }
+  if (!id)
+    id = 1;
+
+  for (int i = 0; i < TIMER_CALLBACK_TYPES; i++) {
+    Entry* entry = &entries_[(id + i) & (TIMER_CALLBACK_TYPES - 1)];
+    if (!entry->id) {
+      entry->id = id;
+      entry->name = name;
+      entry->func = func;
+      size_++;
+      return id;
+    }
+    if (entry->id == id) {
+      if (strcmp(entry->name, name) != 0) {
+        LogWarnM(LOGM_SYS, "timer callback id conflict:%u, %s vs %s", id, entry->name, name);
+        abort();
+      }
+      if (entry->func != func) {
+        LogWarnM(LOGM_SYS, "timer callback key:%s used by two callback types", name);
+        abort();
+      }
+      return id;
+    }
+  }
+  LogWarnM(LOGM_SYS, "timer callback registry full, size:%d", size_);
+  abort();
+  return 0;
+}
+
+TimerCallbackFunc TimerCallbackRegistry::Find(uint32_t id, const char** name) const {
+  for (int i = 0; i < TIMER_CALLBACK_TYPES; i++) {
+    const Entry* entry = &entries_[(id + i) & (TIMER_CALLBACK_TYPES - 1)];
+    if (entry->id == id) {
+      if (name)
+        *name = entry->name;
+      return entry->func;
+    }
+    if (!entry->id)
+      break;
+  }
+  return nullptr;
+}
@@ -0,0 +1,97 @@
+// @brief 内联回调timer: lambda/函数对象直接拷进Timer里, 不用写ExpiryAction子类
+// Timer只存回调的id和最多TIMER_INLINE_PAYLOAD_SIZE字节的payload(lambda捕获的数据).
+// id是调用方给的key字符串的hash, 不用类型名: lambda的类型名每次编译都可能变, 新二进制里
+// 同一个id可能对上另一个lambda. 回调类型要提供key, 两种写法:
+//   struct LoginTimeout {                                  // 具名函数对象
+//     static const char* TimerCallbackKey() { return "login_timeout"; }
+//     int64_t uid;
+//     void operator()(int32_t) { OnLoginTimeout(uid); }
+//   };
+//   timers->SetTimer(LoginTimeout{uid}, Sec(5));
+//   timers->SetTimer(TIMER_CALLBACK("login_timeout", [uid](int32_t) { OnLoginTimeout(uid); }),
+//                    Sec(5));                              // lambda带一个key
+// key要全进程唯一, 捕获的数据布局变了就换一个key, 否则resume后旧payload会按新布局解释.
+// 每个回调类型在进程启动时通过模板静态成员注册, 注册走函数内静态变量, 静态初始化期间
+// SetTimer也能拿到正确的id. resume后遇到新进程里没有注册的id, timer直接丢弃不触发.
+// 要求: 可平凡拷贝, 不超过TIMER_INLINE_PAYLOAD_SIZE字节, 签名为void(int32_t timer_globalid).
+// 捕获的数据要能跨resume: 捕获值或obj_id, 不要捕获进程内的指针/引用.
+//  @author justinzhu
+//  @date 2026年10月19日22:18:36
+
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+#include "singleton.h"
+#include "timer_defines.h"
+
+typedef void (*TimerCallbackFunc)(int32_t timer_globalid, void* payload);
+
+class TimerCallbackRegistry {
+ public:
+  TimerCallbackRegistry();
+
+  // @name 回调的key, 生命周期要覆盖整个进程, 一般是字符串字面量
+  // @return 回调id, 非0. key的hash冲突或者同一个key对应两个回调类型时abort, 换个key即可
+  uint32_t Register(const char* name, TimerCallbackFunc func);
+
+  // @return 没注册过返回nullptr
+  TimerCallbackFunc Find(uint32_t id, const char** name = nullptr) const;
+
+ private:
+  struct Entry {
+    uint32_t id;
+    const char* name;
+    TimerCallbackFunc func;
+  };
+  Entry entries_[TIMER_CALLBACK_TYPES];
+  int32_t size_;
+};
+
+inline TimerCallbackRegistry& GetTimerCallbackRegistry() {
+  return Singleton<TimerCallbackRegistry>::GetInstance();
+}
+
+// F是否提供了static const char* TimerCallbackKey()
+template <typename F, typename = void>
+struct HasTimerCallbackKey : std::false_type {};
+template <typename F>
+struct HasTimerCallbackKey<F, decltype(static_cast<void>(F::TimerCallbackKey()))>
+    : std::true_type {};
+
+template <typename F>
+struct InlineTimerCallback {
+  static void Invoke(int32_t timer_globalid, void* payload) {
+    (*reinterpret_cast<F*>(payload))(timer_globalid);
+  }
+  // 第一次调用时注册, 不依赖静态对象的初始化顺序
+  static uint32_t Id() {
+    static const uint32_t id = GetTimerCallbackRegistry().Register(F::TimerCallbackKey(), &Invoke);
+    static_cast<void>(&kRegistered);
+    return id;
+  }
+  // 模板实例化即在进程启动时注册, resume后旧timer到期前新进程已经认识这个id
+  static const uint32_t kRegistered;
+};
+
+template <typename F>
+const uint32_t InlineTimerCallback<F>::kRegistered = InlineTimerCallback<F>::Id();
+
+// TIMER_CALLBACK把一个key和lambda绑在一起, K是宏里生成的局部类, 只提供key
+template <typename K, typename F>
+struct KeyedTimerCallback {
+  static const char* TimerCallbackKey() { return K::Key(); }
+  F callback;
+  void operator()(int32_t timer_globalid) { callback(timer_globalid); }
+};
+
+// @key 字符串字面量, 全进程唯一
+// @examples: TIMER_CALLBACK("login_timeout", [uid](int32_t) { OnLoginTimeout(uid); })
+#define TIMER_CALLBACK(key, ...)                                                 \
+  ([](auto timer_callback) {                                                     \
+    struct TimerCallbackKeyHolder {                                              \
+      static const char* Key() { return key; }                                   \
+    };                                                                           \
+    using Callback = decltype(timer_callback);                                   \
+    return KeyedTimerCallback<TimerCallbackKeyHolder, Callback>{timer_callback}; \
+  }(__VA_ARGS__))
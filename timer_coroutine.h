@@ -0,0 +1,354 @@
+// @brief 基于TimerSystemInterface的C++20协程工具
+//   co_await TimerSleep(timers, Millis(100));
+//   std::optional<int> r = co_await WithTimeout(timers, Query(uid), Sec(2));
+//   TimerTicker ticker(timers, Sec(1)); while (...) { co_await ticker.Next(); ... }
+// 挂起的协程由RunTimers里的内联回调(timer_callback.h)直接resume, 每次等待不需要new ExpiryAction.
+// 等待中的协程被销毁时, awaiter析构会ClearTimer, 不会留下指向已释放协程帧的timer.
+// 协程帧在进程堆上, 不能跨resume: 回调里会校验pid, 新进程里到期的旧协程timer直接丢弃.
+// 只在C++20下可用, 低版本编译时本文件为空.
+//  @author justinzhu
+//  @date 2026年10月19日23:02:51
+
+#pragma once
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <unistd.h>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "lib_log.h"
+#include "timer_system_interface.h"
+
+// 内联回调的payload: 只存协程相关对象的地址, 它的OnTimer和创建它的进程pid.
+// 所有awaiter共用这一个回调类型和key, 函数地址只在pid校验通过后才使用
+struct TimerCoroutineCallback {
+  static const char* TimerCallbackKey() { return "timer_coroutine"; }
+
+  template <typename T>
+  static TimerCoroutineCallback Make(T* self) {
+    return TimerCoroutineCallback{self, [](void* p) { static_cast<T*>(p)->OnTimer(); }, getpid()};
+  }
+
+  void* self;
+  void (*on_timer)(void* self);
+  pid_t pid;
+  void operator()(int32_t timer_globalid) {
+    if (pid != getpid()) {
+      LogWarnM(LOGM_SYS, "drop coroutine timer:%d created by pid:%d", timer_globalid, pid);
+      return;
+    }
+    on_timer(self);
+  }
+};
+
+// 协程返回类型, 惰性启动: 被co_await或Detach()时才开始执行
+template <typename T = void>
+class TimerTask;
+
+namespace timer_coroutine_detail {
+
+struct PromiseBase {
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+  bool detached = false;
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+
+  // 结束时对称转移回等待者; Detach出去的task没有等待者, 自己销毁
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      PromiseBase& promise = handle.promise();
+      if (promise.detached) {
+        handle.destroy();
+        return std::noop_coroutine();
+      }
+      if (promise.continuation)
+        return promise.continuation;
+      return std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+  FinalAwaiter final_suspend() noexcept { return {}; }
+
+  void unhandled_exception() { exception = std::current_exception(); }
+  void Rethrow() {
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+  std::optional<T> value;
+  TimerTask<T> get_return_object();
+  template <typename U>
+  void return_value(U&& v) {
+    value.emplace(std::forward<U>(v));
+  }
+  T Result() {
+    Rethrow();
+    return std::move(*value);
+  }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+  TimerTask<void> get_return_object();
+  void return_void() {}
+  void Result() { Rethrow(); }
+};
+
+}  // namespace timer_coroutine_detail
+
+template <typename T>
+class TimerTask {
+ public:
+  using promise_type = timer_coroutine_detail::Promise<T>;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  TimerTask() = default;
+  explicit TimerTask(Handle handle) : handle_(handle) {}
+  TimerTask(TimerTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+  TimerTask& operator=(TimerTask&& other) noexcept {
+    if (this != &other) {
+      Cancel();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  TimerTask(const TimerTask&) = delete;
+  TimerTask& operator=(const TimerTask&) = delete;
+  ~TimerTask() { Cancel(); }
+
+  bool Valid() const { return handle_ != nullptr; }
+  bool Done() const { return handle_ && handle_.done(); }
+
+  // 销毁协程帧, 挂起中的awaiter析构时会清掉各自的timer
+  void Cancel() {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  // 作为顶层协程开始执行, 结束后自己释放, 之后本对象不再持有它
+  void Detach() {
+    Handle handle = std::exchange(handle_, nullptr);
+    if (!handle)
+      return;
+    handle.promise().detached = true;
+    handle.resume();
+  }
+
+  // 只在Done()之后调用
+  T Result() { return handle_.promise().Result(); }
+
+  struct Awaiter {
+    Handle handle;
+    bool await_ready() { return handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) {
+      handle.promise().continuation = waiter;
+      return handle;
+    }
+    T await_resume() { return handle.promise().Result(); }
+  };
+  Awaiter operator co_await() & { return Awaiter{handle_}; }
+  Awaiter operator co_await() && { return Awaiter{handle_}; }
+
+ private:
+  template <typename U>
+  friend class TimerTimeoutAwaiter;
+
+  Handle handle_ = nullptr;
+};
+
+namespace timer_coroutine_detail {
+
+template <typename T>
+inline TimerTask<T> Promise<T>::get_return_object() {
+  return TimerTask<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline TimerTask<void> Promise<void>::get_return_object() {
+  return TimerTask<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+}  // namespace timer_coroutine_detail
+
+// co_await TimerSleep(timers, ms), 返回false表示timer创建失败, 没有挂起
+class TimerSleepAwaiter {
+ public:
+  TimerSleepAwaiter(TimerSystemInterface& timers, int64_t expires)
+      : timers_(timers), expires_(expires) {}
+  TimerSleepAwaiter(const TimerSleepAwaiter&) = delete;
+  TimerSleepAwaiter& operator=(const TimerSleepAwaiter&) = delete;
+  ~TimerSleepAwaiter() {
+    if (timer_id_ != INVALID_ID)
+      timers_.ClearTimer(timer_id_);
+  }
+
+  bool await_ready() { return false; }
+  bool await_suspend(std::coroutine_handle<> waiter) {
+    waiter_ = waiter;
+    timer_id_ = timers_.SetTimer(TimerCoroutineCallback::Make(this), expires_);
+    return timer_id_ != INVALID_ID;
+  }
+  bool await_resume() { return waiter_ == nullptr; }
+
+  void OnTimer() {
+    timer_id_ = INVALID_ID;
+    std::exchange(waiter_, nullptr).resume();
+  }
+
+ private:
+  TimerSystemInterface& timers_;
+  int64_t expires_;
+  int32_t timer_id_ = INVALID_ID;
+  std::coroutine_handle<> waiter_ = nullptr;
+};
+
+inline TimerSleepAwaiter TimerSleep(TimerSystemInterface& timers, int64_t expires) {
+  return TimerSleepAwaiter(timers, expires);
+}
+inline TimerSleepAwaiter TimerSleep(TimerSystemInterface& timers, TimeHelper expiry_time) {
+  return TimerSleepAwaiter(timers, expiry_time.GetMillis());
+}
+
+// op和超时timer赛跑: op先完成则清掉timer, 超时先到则销毁op的协程帧
+// await_resume返回true表示op完成. 超时timer创建失败时不执行op, 直接返回false,
+// 这时op没有被销毁(Valid()为true), 可以和超时区分
+template <typename T>
+class TimerTimeoutAwaiter {
+ public:
+  TimerTimeoutAwaiter(TimerSystemInterface& timers, TimerTask<T>& op, int64_t timeout)
+      : timers_(timers), op_(op), timeout_(timeout) {}
+  TimerTimeoutAwaiter(const TimerTimeoutAwaiter&) = delete;
+  TimerTimeoutAwaiter& operator=(const TimerTimeoutAwaiter&) = delete;
+  ~TimerTimeoutAwaiter() {
+    if (timer_id_ != INVALID_ID)
+      timers_.ClearTimer(timer_id_);
+  }
+
+  bool await_ready() { return op_.Done(); }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) {
+    waiter_ = waiter;
+    timer_id_ = timers_.SetTimer(TimerCoroutineCallback::Make(this), timeout_);
+    // 没有超时保护的op可能永远不结束, 不启动它, 立即恢复调用方
+    if (timer_id_ == INVALID_ID)
+      return waiter;
+    op_.handle_.promise().continuation = waiter;
+    return op_.handle_;
+  }
+  bool await_resume() {
+    if (timer_id_ != INVALID_ID) {
+      timers_.ClearTimer(timer_id_);
+      timer_id_ = INVALID_ID;
+    }
+    return op_.Done();
+  }
+
+  void OnTimer() {
+    timer_id_ = INVALID_ID;
+    op_.Cancel();
+    waiter_.resume();
+  }
+
+ private:
+  TimerSystemInterface& timers_;
+  TimerTask<T>& op_;
+  int64_t timeout_;
+  int32_t timer_id_ = INVALID_ID;
+  std::coroutine_handle<> waiter_ = nullptr;
+};
+
+// @return op的结果, 超时或超时timer创建失败返回std::nullopt, 之后op被取消
+template <typename T>
+TimerTask<std::optional<T>> WithTimeout(TimerSystemInterface& timers, TimerTask<T> op,
+                                        int64_t timeout) {
+  TimerTimeoutAwaiter<T> awaiter(timers, op, timeout);
+  if (co_await awaiter)
+    co_return op.Result();
+  co_return std::nullopt;
+}
+template <typename T>
+TimerTask<std::optional<T>> WithTimeout(TimerSystemInterface& timers, TimerTask<T> op,
+                                        TimeHelper timeout) {
+  return WithTimeout(timers, std::move(op), timeout.GetMillis());
+}
+
+// @return true=op完成, false=超时或超时timer创建失败, 之后op被取消
+inline TimerTask<bool> WithTimeout(TimerSystemInterface& timers, TimerTask<void> op,
+                                   int64_t timeout) {
+  TimerTimeoutAwaiter<void> awaiter(timers, op, timeout);
+  bool done = co_await awaiter;
+  if (done)
+    op.Result();
+  co_return done;
+}
+inline TimerTask<bool> WithTimeout(TimerSystemInterface& timers, TimerTask<void> op,
+                                   TimeHelper timeout) {
+  return WithTimeout(timers, std::move(op), timeout.GetMillis());
+}
+
+// 周期tick的异步生成器, 背后是一个循环timer
+// co_await ticker.Next()返回自上次Next以来经过的tick数(>=1), 处理慢了不会丢tick
+// 同一时刻只允许一个协程等待
+class TimerTicker {
+ public:
+  TimerTicker(TimerSystemInterface& timers, int64_t interval) : timers_(timers) {
+    timer_id_ = timers_.SetTimer(TimerCoroutineCallback::Make(this), interval, interval);
+  }
+  TimerTicker(TimerSystemInterface& timers, TimeHelper interval)
+      : TimerTicker(timers, interval.GetMillis()) {}
+  TimerTicker(const TimerTicker&) = delete;
+  TimerTicker& operator=(const TimerTicker&) = delete;
+  ~TimerTicker() {
+    if (timer_id_ != INVALID_ID)
+      timers_.ClearTimer(timer_id_);
+  }
+
+  // 循环timer是否创建成功
+  bool Valid() const { return timer_id_ != INVALID_ID; }
+
+  class Awaiter {
+   public:
+    explicit Awaiter(TimerTicker& ticker) : ticker_(ticker) {}
+    ~Awaiter() {
+      if (ticker_.waiter_ == waiter_)
+        ticker_.waiter_ = nullptr;
+    }
+    bool await_ready() { return ticker_.pending_ > 0 || !ticker_.Valid(); }
+    void await_suspend(std::coroutine_handle<> waiter) {
+      waiter_ = waiter;
+      ticker_.waiter_ = waiter;
+    }
+    int64_t await_resume() {
+      waiter_ = nullptr;
+      return std::exchange(ticker_.pending_, 0);
+    }
+
+   private:
+    TimerTicker& ticker_;
+    std::coroutine_handle<> waiter_ = nullptr;
+  };
+  // timer创建失败时不挂起, 返回0
+  Awaiter Next() { return Awaiter(*this); }
+
+  void OnTimer() {
+    pending_++;
+    if (waiter_)
+      std::exchange(waiter_, nullptr).resume();
+  }
+
+ private:
+  TimerSystemInterface& timers_;
+  int32_t timer_id_ = INVALID_ID;
+  int64_t pending_ = 0;
+  std::coroutine_handle<> waiter_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "timer_cron.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib_time.h"
+
+namespace {
+
+const char* const kMonthNames[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+                                   "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+const char* const kWeekdayNames[] = {"SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"};
+
+struct CronMacro {
+  const char* name;
+  const char* spec;
+};
+const CronMacro kMacros[] = {
+    {"@yearly", "0 0 1 1 *"}, {"@annually", "0 0 1 1 *"}, {"@monthly", "0 0 1 * *"},
+    {"@weekly", "0 0 * * 0"}, {"@daily", "0 0 * * *"},    {"@midnight", "0 0 * * *"},
+    {"@hourly", "0 * * * *"},
+};
+
+// 解析一个数字或英文缩写, names为nullptr表示只接受数字
+// @return 解析到的值, 失败返回-1
+int ParseValue(const char** p, const char* const* names, int name_count, int name_base) {
+  const char* s = *p;
+  if (isdigit(static_cast<unsigned char>(*s))) {
+    int value = 0;
+    while (isdigit(static_cast<unsigned char>(*s))) {
+      value = value * 10 + (*s - '0');
+      if (value > 1000)
+        return -1;
+      s++;
+    }
+    *p = s;
+    return value;
+  }
+  if (!names)
+    return -1;
+  for (int i = 0; i < name_count; i++) {
+    if (strncasecmp(s, names[i], 3) == 0) {
+      *p = s + 3;
+      return i + name_base;
+    }
+  }
+  return -1;
+}
+
+// 解析一个字段到位图
+// @return 0=success, -1=格式错误
+int ParseField(const char* field, size_t len, int min, int max, const char* const* names,
+               int name_count, int name_base, uint64_t* bits, bool* star) {
+  char buf[64];
+  if (len == 0 || len >= sizeof(buf))
+    return -1;
+  memcpy(buf, field, len);
+  buf[len] = '\0';
+
+  *bits = 0;
+  // 和Vixie cron一致: 以*开头(含*/n)都算*, 决定DayMatch里日和周是与还是或
+  *star = buf[0] == '*';
+  const char* p = buf;
+  for (;;) {
+    int lo, hi, step = 1;
+    bool range = false;
+    if (*p == '*') {
+      lo = min;
+      hi = max;
+      p++;
+    } else {
+      lo = ParseValue(&p, names, name_count, name_base);
+      if (lo < 0)
+        return -1;
+      hi = lo;
+      if (*p == '-') {
+        p++;
+        range = true;
+        hi = ParseValue(&p, names, name_count, name_base);
+        if (hi < 0)
+          return -1;
+      }
+    }
+    if (*p == '/') {
+      p++;
+      step = ParseValue(&p, nullptr, 0, 0);
+      if (step <= 0)
+        return -1;
+      // a/n 等价于 a-max/n, a-b/n保持原区间(5-5/2就是5)
+      if (!range)
+        hi = max;
+    }
+    if (lo < min || hi > max || lo > hi)
+      return -1;
+    for (int v = lo; v <= hi; v += step) {
+      *bits |= 1ULL << v;
+    }
+    if (*p == '\0')
+      return 0;
+    if (*p != ',')
+      return -1;
+    p++;
+  }
+}
+
+// 以下两个换算参考 http://howardhinnant.github.io/date_algorithms.html
+int64_t DaysFromCivil(int64_t y, uint32_t m, uint32_t d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const uint32_t yoe = static_cast<uint32_t>(y - era * 400);
+  const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+void CivilFromDays(int64_t z, int64_t* y, uint32_t* m, uint32_t* d) {
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const uint32_t doe = static_cast<uint32_t>(z - era * 146097);
+  const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const uint32_t mp = (5 * doy + 2) / 153;
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp < 10 ? mp + 3 : mp - 9;
+  *y = static_cast<int64_t>(yoe) + era * 400 + (*m <= 2);
+}
+
+uint32_t DaysInMonth(int64_t y, uint32_t m) {
+  static const uint8_t kDays[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if (m == 2 && ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0))
+    return 29;
+  return kDays[m];
+}
+
+// bits里>=from的最低位, 没有返回-1
+int NextBit(uint64_t bits, int from) {
+  if (from >= 64)
+    return -1;
+  uint64_t rest = bits >> from;
+  if (!rest)
+    return -1;
+  return from + __builtin_ctzll(rest);
+}
+
+}  // namespace
+
+int CronSchedule::Compile(const char* spec) {
+  memset(this, 0, sizeof(*this));
+  while (isspace(static_cast<unsigned char>(*spec))) {
+    spec++;
+  }
+  if (*spec == '@') {
+    for (const CronMacro& macro : kMacros) {
+      if (strcasecmp(spec, macro.name) == 0)
+        return Compile(macro.spec);
+    }
+    return -1;
+  }
+
+  const char* fields[5];
+  size_t lens[5];
+  int count = 0;
+  const char* p = spec;
+  while (*p) {
+    while (isspace(static_cast<unsigned char>(*p))) {
+      p++;
+    }
+    if (!*p)
+      break;
+    if (count == 5)
+      return -1;
+    fields[count] = p;
+    while (*p && !isspace(static_cast<unsigned char>(*p))) {
+      p++;
+    }
+    lens[count] = p - fields[count];
+    count++;
+  }
+  if (count != 5)
+    return -1;
+
+  uint64_t bits;
+  bool star;
+  if (ParseField(fields[0], lens[0], 0, 59, nullptr, 0, 0, &bits, &star) != 0)
+    return -1;
+  minutes = bits;
+  if (ParseField(fields[1], lens[1], 0, 23, nullptr, 0, 0, &bits, &star) != 0)
+    return -1;
+  hours = static_cast<uint32_t>(bits);
+  if (ParseField(fields[2], lens[2], 1, 31, nullptr, 0, 0, &bits, &star) != 0)
+    return -1;
+  days = static_cast<uint32_t>(bits);
+  if (star)
+    flags |= CRON_DOM_STAR;
+  if (ParseField(fields[3], lens[3], 1, 12, kMonthNames, 12, 1, &bits, &star) != 0)
+    return -1;
+  months = static_cast<uint16_t>(bits);
+  if (ParseField(fields[4], lens[4], 0, 7, kWeekdayNames, 7, 0, &bits, &star) != 0)
+    return -1;
+  // 7也是周日
+  if (bits & (1 << 7))
+    bits |= 1;
+  weekdays = static_cast<uint8_t>(bits & 0x7F);
+  if (star)
+    flags |= CRON_DOW_STAR;
+  return 0;
+}
+
+bool CronSchedule::DayMatch(int64_t days_since_epoch, uint32_t day) const {
+  bool dom = days & (1U << day);
+  // 1970-01-01是周四
+  int64_t weekday = (days_since_epoch % 7 + 11) % 7;
+  bool dow = weekdays & (1U << weekday);
+  if ((flags & CRON_DOM_STAR) || (flags & CRON_DOW_STAR))
+    return dom && dow;
+  return dom || dow;
+}
+
+// 从t的下一分钟开始, 依次把月/日/时/分推进到位图里下一个置位的值,
+// 低位字段找不到时进位到高一级并把更低的字段清零, 时和分每级都是一次ctz.
+time_t CronSchedule::Next(time_t t) const {
+  const int64_t zone = TIME_ZONE * HOUR_SECOND;
+  int64_t minute_index = (static_cast<int64_t>(t) + zone) / MIN_SECOND + 1;
+  int64_t day_index = minute_index / (24 * 60);
+  int hour = static_cast<int>(minute_index % (24 * 60)) / 60;
+  int minute = static_cast<int>(minute_index % 60);
+  int64_t year;
+  uint32_t month, day;
+  CivilFromDays(day_index, &year, &month, &day);
+  const int64_t last_year = year + CRON_MAX_YEARS;
+
+  auto next_day = [&]() {
+    if (++day > DaysInMonth(year, month)) {
+      day = 1;
+      if (++month > 12) {
+        month = 1;
+        year++;
+      }
+    }
+    day_index++;
+    hour = minute = 0;
+  };
+
+  while (year <= last_year) {
+    if (!(months & (1U << month))) {
+      int next = NextBit(months, month);
+      if (next < 0) {
+        year++;
+        month = NextBit(months, 1);
+      } else {
+        month = next;
+      }
+      day = 1;
+      hour = minute = 0;
+      day_index = DaysFromCivil(year, month, day);
+      continue;
+    }
+    if (!DayMatch(day_index, day)) {
+      next_day();
+      continue;
+    }
+    int next_hour = NextBit(hours, hour);
+    if (next_hour < 0) {
+      next_day();
+      continue;
+    }
+    if (next_hour != hour) {
+      hour = next_hour;
+      minute = 0;
+    }
+    int next_minute = NextBit(minutes, minute);
+    if (next_minute < 0) {
+      if (++hour >= 24) {
+        next_day();
+      } else {
+        minute = 0;
+      }
+      continue;
+    }
+    return static_cast<time_t>(day_index * DAY_SECOND + hour * HOUR_SECOND +
+                               next_minute * MIN_SECOND - zone);
+  }
+  return -1;
+}
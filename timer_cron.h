@@ -0,0 +1,44 @@
+// @brief 预编译的crontab表达式, 给TimerSystem::SetCronTimer用
+// SetCronTimer时解析一次, 每个字段编译成位图, 之后求下一次触发时间只做位运算和日期换算,
+// 不再解析字符串. 纯POD, 直接存在Timer的payload_里, resume不需要处理.
+//
+// 格式: "分 时 日 月 周", 每段支持 * a a-b */n a-b/n 以及用逗号分隔的列表,
+// 月份和星期可以用英文缩写(JAN~DEC, SUN~SAT), 周日为0或7.
+// 也支持 @yearly @monthly @weekly @daily @hourly.
+// 日和周都不以*开头时, 和标准cron一样满足其一即可; 任一以*开头(含*/n)时两者都要满足.
+// 时间按lib_time.h里的TIME_ZONE计算, 不受系统时区设置影响.
+//  @author justinzhu
+//  @date 2026年10月20日11:06:22
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// CronSchedule::flags
+enum CronFlag {
+  CRON_DOM_STAR = 1 << 0,  // 日字段以*开头
+  CRON_DOW_STAR = 1 << 1,  // 周字段以*开头
+};
+
+// 向后最多找这么多年, 找不到(比如2月31日)认为不会触发
+#define CRON_MAX_YEARS (5)
+
+struct CronSchedule {
+  uint64_t minutes;   // bit 0~59
+  uint32_t hours;     // bit 0~23
+  uint32_t days;      // bit 1~31
+  uint16_t months;    // bit 1~12
+  uint8_t weekdays;   // bit 0~6, 0=周日
+  uint8_t flags;      // CronFlag
+
+  // @return 0=success, -1=格式错误
+  int Compile(const char* spec);
+
+  // 严格晚于t的下一次触发时间, 精确到分钟
+  // @return 秒级时间戳, 不会再触发返回-1
+  time_t Next(time_t t) const;
+
+ private:
+  bool DayMatch(int64_t days_since_epoch, uint32_t day) const;
+};
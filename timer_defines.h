@@ -15,3 +15,27 @@
 #define TVN_MASK (TVN_SIZE - 1)
 #define TVR_MASK (TVR_SIZE - 1)
 #define MAX_TVAL ((int64_t)((1ULL << (TVR_BITS + 4 * TVN_BITS)) - 1))
+
+// 超过MAX_TVAL的timer放在溢出堆里, 进入时间轮范围后再迁移进tv5
+#define TIMER_OVERFLOW_CAPACITY (4096)
+
+// SetNamedTimer索引的槽数, 2的幂, 最多容纳3/4个具名timer
+#define TIMER_NAME_INDEX_CAPACITY (16384)
+
+// ClearAll作废的timer每次RunTimers最多回收这么多个
+#define TIMER_STALE_RECLAIM_BATCH (4096)
+
+// 内联回调timer的payload上限(字节), 以及进程内最多注册的回调类型数(2的幂)
+#define TIMER_INLINE_PAYLOAD_SIZE (32)
+#define TIMER_CALLBACK_TYPES (1024)
+
+// 每个timer系统最多统计的创建位置数(2的幂), 见timer_site.h
+#define TIMER_SITE_CAPACITY (256)
+
+// timer id: 没有被slab复用过的timer就是它的globalid; 复用过的置上TIMER_ID_REUSED,
+// [29:24]是generation, [23:0]是globalid, 旧id和复用后的新id不相等. 只有开过slab的系统
+// 才这样解码, generation用完后还给对象池. globalid的限制见TimerSystem::SetTimerSlabCapacity
+#define TIMER_ID_REUSED (1 << 30)
+#define TIMER_ID_GENERATION_SHIFT (24)
+#define TIMER_ID_GENERATION_MAX (63)
+#define TIMER_ID_GLOBALID_MASK ((1 << TIMER_ID_GENERATION_SHIFT) - 1)
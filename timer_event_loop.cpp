@@ -0,0 +1,275 @@
+#include "timer_event_loop.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "lib_log.h"
+#include "lib_time_source.h"
+
+// timeout remove的完成事件用这个标记区分
+#define TIMER_URING_REMOVE_TAG (1ULL << 63)
+// 一次Arm最多提交remove和新timeout两个sqe
+#define TIMER_URING_ENTRIES (2)
+// Arm提交前先收割CQ, 之后CQ里最多有: remove的完成, 被remove的旧timeout的-ECANCELED,
+// 新timeout到期的完成, 共3个. 留出余量, 自己的ring上不会出现CQ溢出
+#define TIMER_URING_CQ_ENTRIES (8)
+
+TimerLoopAdapter::TimerLoopAdapter(TimerSystemInterface* timers)
+    : timers_(timers), fd_(-1), armed_(-1), wakeups_(0), running_(false) {}
+
+TimerLoopAdapter::~TimerLoopAdapter() {
+  // Init失败或者已经换成别的listener(比如新的适配器)时不能清掉别人的
+  if (timers_->ArmListener() == this)
+    timers_->SetArmListener(nullptr);
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+void TimerLoopAdapter::OnTimerArmed(int64_t expires) {
+  if (running_)
+    return;
+  if (armed_ < 0 || expires < armed_)
+    Arm(expires);
+}
+
+void TimerLoopAdapter::RunAndRearm() {
+  wakeups_++;
+  running_ = true;
+  GetTimeSource().UpdateTime();
+  timers_->RunTimers(timers_->NowMs());
+  running_ = false;
+  Arm(timers_->NextExpiry());
+}
+
+void TimerLoopAdapter::ToTimespec(int64_t expires, struct timespec* ts) {
+  ts->tv_sec = expires / SECOND_MS;
+  ts->tv_nsec = (expires % SECOND_MS) * 1000000;
+}
+
+int TimerFdAdapter::Init() {
+  fd_ = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd_ < 0) {
+    LogWarnM(LOGM_SYS, "timerfd_create failed, errno:%d", errno);
+    return -1;
+  }
+  timers_->SetArmListener(this);
+  Arm(timers_->NextExpiry());
+  return 0;
+}
+
+void TimerFdAdapter::OnReadable() {
+  uint64_t expirations;
+  if (read(fd_, &expirations, sizeof(expirations)) != sizeof(expirations))
+    return;
+  armed_ = -1;
+  RunAndRearm();
+}
+
+void TimerFdAdapter::Arm(int64_t expires) {
+  if (expires == armed_)
+    return;
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  // it_value全0表示取消; 已经过去的时间点会立即触发
+  if (expires >= 0)
+    ToTimespec(expires, &spec.it_value);
+  if (timerfd_settime(fd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+    LogWarnM(LOGM_SYS, "timerfd_settime failed, errno:%d expires:%ld", errno, expires);
+    return;
+  }
+  armed_ = expires;
+}
+
+TimerUringAdapter::TimerUringAdapter(TimerSystemInterface* timers)
+    : TimerLoopAdapter(timers),
+      sq_ring_(MAP_FAILED),
+      sq_ring_size_(0),
+      cq_ring_(MAP_FAILED),
+      cq_ring_size_(0),
+      sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+      sqes_size_(0),
+      generation_(0) {
+  memset(&params_, 0, sizeof(params_));
+  memset(&ts_, 0, sizeof(ts_));
+}
+
+TimerUringAdapter::~TimerUringAdapter() { Unmap(); }
+
+void TimerUringAdapter::Unmap() {
+  if (sqes_ != MAP_FAILED)
+    munmap(sqes_, sqes_size_);
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+    munmap(cq_ring_, cq_ring_size_);
+  if (sq_ring_ != MAP_FAILED)
+    munmap(sq_ring_, sq_ring_size_);
+  sqes_ = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+  cq_ring_ = sq_ring_ = MAP_FAILED;
+}
+
+int TimerUringAdapter::Init() {
+  params_.flags = IORING_SETUP_CQSIZE;
+  params_.cq_entries = TIMER_URING_CQ_ENTRIES;
+  fd_ = syscall(__NR_io_uring_setup, TIMER_URING_ENTRIES, &params_);
+  if (fd_ < 0) {
+    LogWarnM(LOGM_SYS, "io_uring_setup failed, errno:%d", errno);
+    return -1;
+  }
+
+  sq_ring_size_ = params_.sq_off.array + params_.sq_entries * sizeof(uint32_t);
+  cq_ring_size_ = params_.cq_off.cqes + params_.cq_entries * sizeof(struct io_uring_cqe);
+  if (params_.features & IORING_FEAT_SINGLE_MMAP) {
+    if (cq_ring_size_ > sq_ring_size_)
+      sq_ring_size_ = cq_ring_size_;
+    cq_ring_size_ = sq_ring_size_;
+  }
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                  IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED)
+    goto fail;
+  if (params_.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED)
+      goto fail;
+  }
+  sqes_size_ = params_.sq_entries * sizeof(struct io_uring_sqe);
+  sqes_ = static_cast<struct io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_POPULATE, fd_,
+                                                 IORING_OFF_SQES));
+  if (sqes_ == MAP_FAILED)
+    goto fail;
+
+  {
+    char* sq = static_cast<char*>(sq_ring_);
+    char* cq = static_cast<char*>(cq_ring_);
+    sq_head_ = reinterpret_cast<uint32_t*>(sq + params_.sq_off.head);
+    sq_tail_ = reinterpret_cast<uint32_t*>(sq + params_.sq_off.tail);
+    sq_mask_ = reinterpret_cast<uint32_t*>(sq + params_.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<uint32_t*>(sq + params_.sq_off.array);
+    cq_head_ = reinterpret_cast<uint32_t*>(cq + params_.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t*>(cq + params_.cq_off.tail);
+    cq_mask_ = reinterpret_cast<uint32_t*>(cq + params_.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params_.cq_off.cqes);
+  }
+
+  timers_->SetArmListener(this);
+  Arm(timers_->NextExpiry());
+  return 0;
+
+fail:
+  LogWarnM(LOGM_SYS, "io_uring mmap failed, errno:%d", errno);
+  Unmap();
+  close(fd_);
+  fd_ = -1;
+  return -1;
+}
+
+struct io_uring_sqe* TimerUringAdapter::GetSqe() {
+  uint32_t tail = *sq_tail_;
+  if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= params_.sq_entries)
+    return nullptr;
+  uint32_t index = tail & *sq_mask_;
+  struct io_uring_sqe* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  return sqe;
+}
+
+int TimerUringAdapter::Submit(uint32_t count) {
+  int ret = syscall(__NR_io_uring_enter, fd_, count, 0, 0, nullptr, 0);
+  if (ret < 0) {
+    LogWarnM(LOGM_SYS, "io_uring_enter failed, errno:%d", errno);
+  }
+  return ret;
+}
+
+bool TimerUringAdapter::Reap() {
+  bool fired = false;
+  uint32_t head = *cq_head_;
+  while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+    if (cqe->user_data == generation_ && cqe->res == -ETIME)
+      fired = true;
+    head++;
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  return fired;
+}
+
+void TimerUringAdapter::Arm(int64_t expires) {
+  // 当前的timeout已经到期就不用再remove, 新的唤醒时间不晚于它, 会立即触发
+  if (Reap())
+    armed_ = -1;
+  if (expires == armed_)
+    return;
+
+  // 没有SQPOLL, sqe只在io_uring_enter时被内核取走, 失败时可以把tail退回去
+  uint32_t tail = *sq_tail_;
+  uint32_t count = 0;
+  if (armed_ >= 0) {
+    struct io_uring_sqe* sqe = GetSqe();
+    if (!sqe)
+      return;
+    sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = generation_;
+    sqe->user_data = generation_ | TIMER_URING_REMOVE_TAG;
+    count++;
+  }
+  if (expires >= 0) {
+    struct io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+      return;
+    }
+    struct timespec ts;
+    ToTimespec(expires, &ts);
+    ts_.tv_sec = ts.tv_sec;
+    ts_.tv_nsec = ts.tv_nsec;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&ts_);
+    sqe->len = 1;
+    sqe->off = 0;  // 纯超时, 不等其他完成事件
+    sqe->timeout_flags = IORING_TIMEOUT_ABS | IORING_TIMEOUT_REALTIME;
+    sqe->user_data = generation_ + 1;
+    count++;
+  }
+
+  int ret = Submit(count);
+  if (ret < static_cast<int>(count)) {
+    // 没有提交的sqe退回去, 下次Arm重新生成
+    __atomic_store_n(sq_tail_, __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    if (ret <= 0)
+      return;  // 什么都没提交, 旧timeout仍然有效
+    // 只提交了排在前面的remove, 旧timeout没了, 新的没设上
+    LogWarnM(LOGM_SYS, "io_uring timeout not armed, expires:%ld", expires);
+    generation_++;
+    armed_ = -1;
+    return;
+  }
+  generation_++;
+  armed_ = expires >= 0 ? expires : -1;
+}
+
+void TimerUringAdapter::OnReadable() {
+  if (Reap()) {
+    armed_ = -1;
+    RunAndRearm();
+  }
+}
+
+int TimerUringAdapter::Wait() {
+  int ret = syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+  if (ret < 0 && errno != EINTR) {
+    LogWarnM(LOGM_SYS, "io_uring_enter wait failed, errno:%d", errno);
+    return -1;
+  }
+  OnReadable();
+  return 0;
+}
@@ -0,0 +1,110 @@
+// @brief 事件循环适配器: 用一个timerfd或io_uring timeout跟踪timer系统最早的超时
+// 进程不再按固定帧调用RunTimers, 而是把Fd()加进自己的epoll/io_uring, 可读时调用OnReadable().
+// 适配器总是把唤醒时间设成NextExpiry(): 有更早的timer加入时通过TimerArmListener立即提前,
+// timer被删除时不处理, 最多多醒来一次. 没有timer时不会醒来.
+// 唤醒时间按CLOCK_REALTIME的绝对时间设置, RunTimers按timers->NowMs()执行, timer系统的时钟
+// 要和CLOCK_REALTIME一致(默认时钟即可), 虚拟时钟用TimerSimulator驱动.
+//
+//   TimerFdAdapter adapter(&GetTimerSystem());
+//   adapter.Init();
+//   epoll_ctl(epfd, EPOLL_CTL_ADD, adapter.Fd(), &ev);  // EPOLLIN
+//   ... epoll_wait返回adapter.Fd()可读时: adapter.OnReadable();
+//
+// TimerUringAdapter自带一个很小的ring(直接用系统调用, 不依赖liburing), 它的fd同样可以poll,
+// 也可以在自己的ring上用IORING_OP_POLL_ADD监听它, 或者直接用Wait()阻塞.
+//  @author justinzhu
+//  @date 2026年10月20日10:12:40
+
+#pragma once
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <time.h>
+#include "timer_system_interface.h"
+
+class TimerLoopAdapter : public TimerArmListener {
+ public:
+  explicit TimerLoopAdapter(TimerSystemInterface* timers);
+  virtual ~TimerLoopAdapter();
+
+  // 创建fd, 注册到timers上并按当前最早超时设置唤醒
+  // @return 0=success, <0=failed
+  virtual int Init() = 0;
+  // fd可读时调用, 到期后更新时间源, 执行RunTimers并重新设置唤醒
+  virtual void OnReadable() = 0;
+
+  int Fd() const { return fd_; }
+  // 当前设置的唤醒jiffies, -1表示未设置
+  int64_t ArmedExpires() const { return armed_; }
+  // 实际执行RunTimers的次数, 用于观察空闲唤醒
+  int64_t Wakeups() const { return wakeups_; }
+
+  virtual void OnTimerArmed(int64_t expires) override;
+
+ protected:
+  // @expires 唤醒jiffies, -1表示取消
+  virtual void Arm(int64_t expires) = 0;
+  void RunAndRearm();
+  static void ToTimespec(int64_t expires, struct timespec* ts);
+
+ protected:
+  TimerSystemInterface* timers_;
+  int fd_;
+  int64_t armed_;
+  int64_t wakeups_;
+  bool running_;  // RunTimers期间加入的timer不单独重设, 结束后统一按NextExpiry设置
+};
+
+class TimerFdAdapter : public TimerLoopAdapter {
+ public:
+  explicit TimerFdAdapter(TimerSystemInterface* timers) : TimerLoopAdapter(timers) {}
+
+  virtual int Init() override;
+  virtual void OnReadable() override;
+
+ protected:
+  virtual void Arm(int64_t expires) override;
+};
+
+class TimerUringAdapter : public TimerLoopAdapter {
+ public:
+  explicit TimerUringAdapter(TimerSystemInterface* timers);
+  virtual ~TimerUringAdapter();
+
+  virtual int Init() override;
+  // 收割完成事件, 本适配器的timeout到期时执行RunTimers
+  virtual void OnReadable() override;
+  // 阻塞直到有完成事件再调用OnReadable, 给只有timer要等的进程用
+  // @return 0=success, <0=failed
+  int Wait();
+
+ protected:
+  virtual void Arm(int64_t expires) override;
+
+ private:
+  struct io_uring_sqe* GetSqe();
+  int Submit(uint32_t count);
+  // 收割所有完成事件
+  // @return 当前generation的timeout是否到期
+  bool Reap();
+  void Unmap();
+
+ private:
+  struct io_uring_params params_;
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  struct io_uring_sqe* sqes_;
+  size_t sqes_size_;
+  uint32_t* sq_head_;
+  uint32_t* sq_tail_;
+  uint32_t* sq_mask_;
+  uint32_t* sq_array_;
+  uint32_t* cq_head_;
+  uint32_t* cq_tail_;
+  uint32_t* cq_mask_;
+  struct io_uring_cqe* cqes_;
+  uint64_t generation_;  // 每次Arm递增, 作为timeout的user_data, 过期的完成事件直接忽略
+  struct __kernel_timespec ts_;
+};
@@ -0,0 +1,140 @@
+// @brief 事件循环适配器自检: 时间轮和堆两种timer系统分别配TimerFdAdapter和TimerUringAdapter
+// 用epoll等待适配器的fd, 检查:
+//   1. 所有timer都按时触发, 回调里新加的timer也能唤醒
+//   2. 被删除的timer不触发, 没有timer时不会空转
+//   3. 不收割完成事件的情况下连续提前唤醒时间(每次都是remove+重设), ring不会溢出
+// 对象池和共享内存由comm库初始化, 和timer_bench一样.
+// 内核不支持io_uring时跳过uring的用例.
+//
+// usage: timer_event_loop_test
+// @return 0=全部通过, 1=有失败
+//  @author justinzhu
+//  @date 2026年10月23日10:41:16
+
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "lib_time_source.h"
+#include "timer_event_loop.h"
+#include "timer_system_interface.h"
+
+namespace {
+
+int64_t WallMs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+int g_failed = 0;
+
+#define EXPECT(cond, ...)                          \
+  do {                                             \
+    if (!(cond)) {                                 \
+      printf("FAILED %s:%d ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                         \
+      printf("\n");                                \
+      g_failed++;                                  \
+    }                                              \
+  } while (0)
+
+// user_data是期望的触发时间点, 记录最大延迟; chain为true时第3次触发时再加一个5ms的timer
+class CheckAction : public ExpiryAction {
+ public:
+  CheckAction(TimerSystemInterface* timers, bool chain) : timers_(timers), chain_(chain) {}
+  virtual void OnExpiry(int32_t timer_globalid, int64_t due) override {
+    fired_++;
+    int64_t late = WallMs() - due;
+    if (late < 0)
+      early_++;
+    if (late > max_late_)
+      max_late_ = late;
+    if (chain_ && fired_ == 3)
+      timers_->SetTimer(this, 5, 0, timers_->NowMs() + 5);
+  }
+
+  int fired_ = 0;
+  int early_ = 0;
+  int64_t max_late_ = 0;
+
+ private:
+  TimerSystemInterface* timers_;
+  bool chain_;
+};
+
+// 在deadline前用epoll等适配器的fd, 返回epoll_wait的循环次数
+int Loop(TimerLoopAdapter* adapter, int64_t deadline) {
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = adapter->Fd();
+  epoll_ctl(epfd, EPOLL_CTL_ADD, adapter->Fd(), &ev);
+  int loops = 0;
+  for (int64_t now = WallMs(); now < deadline; now = WallMs()) {
+    struct epoll_event out;
+    if (epoll_wait(epfd, &out, 1, static_cast<int>(deadline - now)) > 0)
+      adapter->OnReadable();
+    loops++;
+  }
+  close(epfd);
+  return loops;
+}
+
+void TestAdapter(TimerBackend backend, bool uring) {
+  const char* name = uring ? "uring" : "timerfd";
+  const char* engine = backend == TIMER_BACKEND_HEAP ? "heap" : "wheel";
+  GetTimeSource().UpdateTime();
+  TimerSystemInterface* timers = CreateTimerSystem(backend, GetRealTickTimeMs());
+  EXPECT(timers != nullptr, "%s/%s CreateTimerSystem", name, engine);
+  if (!timers)
+    return;
+  TimerLoopAdapter* adapter = uring ? static_cast<TimerLoopAdapter*>(new TimerUringAdapter(timers))
+                                    : new TimerFdAdapter(timers);
+  if (adapter->Init() != 0) {
+    printf("skip %s/%s, adapter init failed\n", name, engine);
+    delete adapter;
+    return;
+  }
+
+  // 连续把唤醒时间往前提, 中间不收割完成事件
+  CheckAction burst(timers, false);
+  for (int i = 0; i < 64; i++) {
+    int64_t delay = 400 - i;
+    timers->SetTimer(&burst, delay, 0, timers->NowMs() + delay);
+  }
+
+  CheckAction action(timers, true);
+  const int64_t delays[] = {30, 10, 50, 200, 20};
+  for (int64_t delay : delays) {
+    timers->SetTimer(&action, delay, 0, timers->NowMs() + delay);
+  }
+  int32_t cleared = timers->SetTimer(&action, 15, 0, timers->NowMs() + 15);
+  timers->ClearTimer(cleared);
+
+  int loops = Loop(adapter, WallMs() + 600);
+  EXPECT(action.fired_ == 6, "%s/%s fired:%d", name, engine, action.fired_);
+  EXPECT(burst.fired_ == 64, "%s/%s burst fired:%d", name, engine, burst.fired_);
+  EXPECT(action.early_ == 0 && burst.early_ == 0, "%s/%s fired early", name, engine);
+  EXPECT(action.max_late_ < 20 && burst.max_late_ < 20, "%s/%s max late:%ld/%ld", name, engine,
+         action.max_late_, burst.max_late_);
+  EXPECT(adapter->ArmedExpires() == -1, "%s/%s still armed:%ld", name, engine,
+         adapter->ArmedExpires());
+  // 70个不同的到期时间点, 每个最多醒一次, 跨毫秒边界时允许多醒一两次
+  EXPECT(adapter->Wakeups() <= 6 + 64 + 2, "%s/%s wakeups:%ld", name, engine, adapter->Wakeups());
+  printf("%s/%s wakeups:%ld loops:%d max_late:%ldms\n", name, engine, adapter->Wakeups(), loops,
+         action.max_late_ > burst.max_late_ ? action.max_late_ : burst.max_late_);
+  delete adapter;
+}
+
+}  // namespace
+
+int main() {
+  const TimerBackend backends[] = {TIMER_BACKEND_WHEEL, TIMER_BACKEND_HEAP};
+  for (TimerBackend backend : backends) {
+    TestAdapter(backend, false);
+    TestAdapter(backend, true);
+  }
+  printf("%s\n", g_failed ? "FAILED" : "PASSED");
+  return g_failed ? 1 : 0;
+}
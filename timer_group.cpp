@@ -0,0 +1,56 @@
+#include "timer_group.h"
+
+IMPLEMENT_IDCREATE_WITHTYPE(TimerGroup, EOT_OBJ_TIMER_GROUP, CObj)
+
+TimerGroup::TimerGroup() {
+  if (SHM_MODE_INIT == get_shm_mode()) {
+    CreateInit();
+  } else {
+    ResumeInit();
+  }
+}
+
+void TimerGroup::CreateInit() {
+  head_ = INVALID_ID;
+  size_ = 0;
+  owner_id_ = INVALID_ID;
+}
+
+TimerGroup::~TimerGroup() {
+  // 组先于成员销毁时把成员摘干净, 不留指向已释放组的group_id_
+  while (Timer *timer = First()) {
+    Remove(timer);
+  }
+}
+
+void TimerGroup::Add(Timer *timer) {
+  Leave(timer);
+  int32_t self = timer->GetObjectID();
+  timer->group_id_ = GetObjectID();
+  timer->group_prev_ = INVALID_ID;
+  timer->group_next_ = head_;
+  if (head_ >= 0)
+    Timer::GetObjectByID(head_)->group_prev_ = self;
+  head_ = self;
+  size_++;
+}
+
+void TimerGroup::Remove(Timer *timer) {
+  if (timer->group_prev_ >= 0) {
+    Timer::GetObjectByID(timer->group_prev_)->group_next_ = timer->group_next_;
+  } else {
+    head_ = timer->group_next_;
+  }
+  if (timer->group_next_ >= 0)
+    Timer::GetObjectByID(timer->group_next_)->group_prev_ = timer->group_prev_;
+  timer->group_id_ = INVALID_ID;
+  timer->group_prev_ = INVALID_ID;
+  timer->group_next_ = INVALID_ID;
+  size_--;
+}
+
+void TimerGroup::Leave(Timer *timer) {
+  if (timer->group_id_ < 0)
+    return;
+  TimerGroup::GetObjectByID(timer->group_id_)->Remove(timer);
+}
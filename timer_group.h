@@ -0,0 +1,50 @@
+// @brief Timer组, 一个实体的所有timer挂在同一个组上, 实体销毁时ClearTimerGroup一次清掉
+// 组内成员通过Timer上的第二条侵入式链表(group_prev_/group_next_)串起来, 清除时直接遍历链表,
+// 不需要逐个GetObjFromGlobalID. Timer销毁时(一次性timer到期, ClearTimer)自动退出所在的组.
+// 组属于创建它的timer系统, 只接受这个系统的timer, 别的系统对它的操作都失败.
+//  @author justinzhu
+//  @date 2026年10月19日21:05:43
+
+#pragma once
+
+#include "comm_base.h"
+#include "comm_object.h"
+#include "timer.h"
+
+// TimerGroup定义
+// @CObj 共享内存存储，可恢复, 链表里存的都是obj_id
+class TimerGroup : public CObj {
+ public:
+  TimerGroup();
+  virtual ~TimerGroup();
+  void CreateInit();
+  void ResumeInit() {}
+
+  std::string DebugString() {
+    return format_string("(globalid:%d, head:%d, size:%d, owner:%d)", GetGlobalID(), head_, size_,
+                         owner_id_);
+  }
+
+ public:
+  int32_t Size() { return size_; }
+  // 所属timer系统的globalid
+  int32_t OwnerID() { return owner_id_; }
+  void SetOwnerID(int32_t owner_id) { owner_id_ = owner_id; }
+  bool Empty() { return size_ == 0; }
+  // 第一个成员, 空组返回nullptr
+  Timer *First() { return head_ >= 0 ? Timer::GetObjectByID(head_) : nullptr; }
+
+  // 加入本组, 已经在别的组里的timer先退出原来的组
+  void Add(Timer *timer);
+  void Remove(Timer *timer);
+
+  // timer退出它所在的组, 不在组里时什么都不做
+  static void Leave(Timer *timer);
+
+ private:
+  int32_t head_;      // 第一个成员timer的obj_id, -1表示空
+  int32_t size_;      // 成员数
+  int32_t owner_id_;  // 所属timer系统的globalid
+
+  DECLARE_IDCREATE(TimerGroup);
+};
@@ -0,0 +1,127 @@
+// @brief 定长的4叉最小堆, 按(expires, seq)排序, seq保证同一expires下FIFO
+// 节点里存的是Timer的obj_id, Timer::heap_index_记录自己在堆里的位置, 所以删除是O(log n).
+// 纯POD数据, 可以直接放在共享内存的对象里, resume不需要处理.
+//  @author justinzhu
+//  @date 2026年10月19日16:31:27
+
+#pragma once
+
+#include <stdint.h>
+#include "timer.h"
+
+#define TIMER_HEAP_ARITY (4)
+
+struct TimerHeapNode {
+  int64_t expires;
+  uint32_t seq;      // 入堆序号, 回绕比较
+  int32_t timer_id;  // Timer的obj_id
+};
+
+template <int CAPACITY>
+class TimerHeap {
+ public:
+  void Clear() {
+    size_ = 0;
+    seq_ = 0;
+  }
+
+  int32_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+  bool Full() const { return size_ >= CAPACITY; }
+
+  // 堆顶的超时时间, 空堆时无意义
+  int64_t TopExpires() const { return nodes_[0].expires; }
+  Timer* Top() const { return Timer::GetObjectByID(nodes_[0].timer_id); }
+
+  // @return 0=success, -1=堆满
+  int Push(Timer* timer) {
+    if (Full())
+      return -1;
+    int32_t index = size_++;
+    nodes_[index].expires = timer->Expires();
+    nodes_[index].seq = seq_++;
+    nodes_[index].timer_id = timer->GetObjectID();
+    timer->heap_index_ = index;
+    SiftUp(index);
+    return 0;
+  }
+
+  Timer* Pop() {
+    Timer* timer = Top();
+    Remove(timer);
+    return timer;
+  }
+
+  void Remove(Timer* timer) {
+    int32_t index = timer->heap_index_;
+    timer->heap_index_ = -1;
+    if (--size_ == index)
+      return;
+    Move(size_, index);
+    if (index > 0 && Less(index, Parent(index))) {
+      SiftUp(index);
+    } else {
+      SiftDown(index);
+    }
+  }
+
+  // 按第i个节点遍历, 用于析构或整体迁移
+  Timer* At(int32_t index) const { return Timer::GetObjectByID(nodes_[index].timer_id); }
+
+ private:
+  static int32_t Parent(int32_t index) { return (index - 1) / TIMER_HEAP_ARITY; }
+
+  bool Less(int32_t a, int32_t b) const {
+    if (nodes_[a].expires != nodes_[b].expires)
+      return nodes_[a].expires < nodes_[b].expires;
+    return static_cast<int32_t>(nodes_[a].seq - nodes_[b].seq) < 0;
+  }
+
+  void Move(int32_t from, int32_t to) {
+    nodes_[to] = nodes_[from];
+    Timer::GetObjectByID(nodes_[to].timer_id)->heap_index_ = to;
+  }
+
+  void SiftUp(int32_t index) {
+    TimerHeapNode node = nodes_[index];
+    while (index > 0) {
+      int32_t parent = Parent(index);
+      const TimerHeapNode& p = nodes_[parent];
+      if (p.expires < node.expires ||
+          (p.expires == node.expires && static_cast<int32_t>(p.seq - node.seq) < 0))
+        break;
+      Move(parent, index);
+      index = parent;
+    }
+    nodes_[index] = node;
+    Timer::GetObjectByID(node.timer_id)->heap_index_ = index;
+  }
+
+  void SiftDown(int32_t index) {
+    for (;;) {
+      int32_t first = index * TIMER_HEAP_ARITY + 1;
+      if (first >= size_)
+        break;
+      int32_t last = first + TIMER_HEAP_ARITY;
+      if (last > size_)
+        last = size_;
+      int32_t min = first;
+      for (int32_t child = first + 1; child < last; child++) {
+        if (Less(child, min))
+          min = child;
+      }
+      if (!Less(min, index))
+        break;
+      TimerHeapNode tmp = nodes_[index];
+      Move(min, index);
+      nodes_[min] = tmp;
+      Timer::GetObjectByID(tmp.timer_id)->heap_index_ = min;
+      index = min;
+    }
+  }
+
+ private:
+  int32_t size_;
+  uint32_t seq_;
+  TimerHeapNode nodes_[CAPACITY];
+};
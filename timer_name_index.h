@@ -0,0 +1,99 @@
+// @brief (action, key) -> Timer的开放寻址索引, 给SetNamedTimer/FindNamedTimer/ClearNamedTimer用
+// 线性探测, 删除时做backward shift, 没有墓碑. 只按key做hash, action通过节点指向的Timer比较,
+// 所以resume后action地址变化也不需要重建索引. 纯POD数据, 和TimerHeap一样直接放在共享内存的对象里.
+//  @author justinzhu
+//  @date 2026年10月19日21:47:10
+
+#pragma once
+
+#include <stdint.h>
+#include "timer.h"
+
+struct TimerNameNode {
+  int64_t key;
+  int32_t timer_id;  // Timer的obj_id, -1表示空槽
+};
+
+// CAPACITY必须是2的幂, 装载率上限3/4
+template <int CAPACITY>
+class TimerNameIndex {
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be power of 2");
+
+ public:
+  void Clear() {
+    size_ = 0;
+    for (int32_t i = 0; i < CAPACITY; i++) {
+      nodes_[i].timer_id = -1;
+    }
+  }
+
+  int32_t Size() const { return size_; }
+  bool Full() const { return size_ >= CAPACITY / 4 * 3; }
+
+  // @return 没有时返回nullptr
+  Timer* Find(ExpiryAction* action, int64_t key) const {
+    for (uint32_t i = Slot(key);; i = (i + 1) & (CAPACITY - 1)) {
+      const TimerNameNode& node = nodes_[i];
+      if (node.timer_id < 0)
+        return nullptr;
+      if (node.key == key) {
+        Timer* timer = Timer::GetObjectByID(node.timer_id);
+        if (timer->Action() == action)
+          return timer;
+      }
+    }
+  }
+
+  // 调用方保证(action, key)不在索引里
+  // @return 0=success, -1=索引满
+  int Insert(Timer* timer, int64_t key) {
+    if (Full())
+      return -1;
+    uint32_t i = Slot(key);
+    while (nodes_[i].timer_id >= 0) {
+      i = (i + 1) & (CAPACITY - 1);
+    }
+    nodes_[i].key = key;
+    nodes_[i].timer_id = timer->GetObjectID();
+    timer->SetNameKey(key);
+    timer->SetFlag(TIMER_FLAG_NAMED);
+    size_++;
+    return 0;
+  }
+
+  // 不在索引里的timer什么都不做
+  void Remove(Timer* timer) {
+    if (!timer->Named())
+      return;
+    timer->ClearFlag(TIMER_FLAG_NAMED);
+    int32_t timer_id = timer->GetObjectID();
+    uint32_t i = Slot(timer->NameKey());
+    while (nodes_[i].timer_id != timer_id) {
+      i = (i + 1) & (CAPACITY - 1);
+    }
+    // backward shift: 把后面探测链上的节点往前挪, 保证查找遇到空槽即可停止
+    for (uint32_t j = (i + 1) & (CAPACITY - 1); nodes_[j].timer_id >= 0;
+         j = (j + 1) & (CAPACITY - 1)) {
+      uint32_t home = Slot(nodes_[j].key);
+      if (((j - home) & (CAPACITY - 1)) >= ((j - i) & (CAPACITY - 1))) {
+        nodes_[i] = nodes_[j];
+        i = j;
+      }
+    }
+    nodes_[i].timer_id = -1;
+    size_--;
+  }
+
+ private:
+  static uint32_t Slot(int64_t key) {
+    uint64_t h = static_cast<uint64_t>(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<uint32_t>(h) & (CAPACITY - 1);
+  }
+
+ private:
+  int32_t size_;
+  TimerNameNode nodes_[CAPACITY];
+};
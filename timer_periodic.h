@@ -0,0 +1,238 @@
+// @brief 分桶的周期调度器: 大量实体按同一个周期tick时, 不再每个实体一个循环timer
+// 一个周期分成BUCKETS个相位桶, 每个桶对应时间轮上的一个循环timer(相位错开),
+// 桶里是实体id的稠密数组, timer到期时顺序遍历数组对每个实体调用action->OnExpiry.
+// 每个周期的重挂从"实体数"次降到BUCKETS次, 遍历是连续内存.
+//
+// Add返回句柄, Add/Remove都是O(1): 桶内删除用最后一个元素填洞, 句柄表记录每个实体的位置.
+// 回调里可以Add/Remove, 包括删除自己; 正在遍历的桶里的删除先打标记, 遍历完再压缩.
+// 新加入的实体在所在桶下一次到期时开始tick, 距离加入最多一个周期.
+//
+// 纯数据加ExpiryAction虚表, 和TimerHeap一样直接作为成员放在共享内存对象里,
+// resume时外层对象重新构造会修复虚表, 再调用ResumeInit修正action指针.
+//
+//   TimerPeriodicScheduler<1 << 20, 64> regen_;  // 共享内存对象的成员
+//   regen_.Init();
+//   regen_.Start(GetTimerSystem(), &regen_action, 1000);  // 每秒, OnExpiry的user_data是实体id
+// 实体回调的timer_globalid总是INVALID_ID: 桶timer是所有实体共用的, 不能交给实体去ClearTimer/
+// ResetTimer, 实体要停止tick时用Add返回的句柄Remove.
+//   int64_t handle = regen_.Add(npc_id);
+//   regen_.Remove(handle);
+//  @author justinzhu
+//  @date 2026年10月20日15:52:06
+
+#pragma once
+
+#include <stdint.h>
+#include "comm_base.h"
+#include "expiry_action.h"
+#include "lib_log.h"
+#include "timer_system_interface.h"
+
+#define TIMER_PERIODIC_REMOVED (-1)  // 遍历中被删除的桶内位置
+
+// @CAPACITY 最多注册的实体数, 每个桶最多CAPACITY/BUCKETS个
+// @BUCKETS 相位桶数, 也是时间轮上的timer数
+template <int CAPACITY, int BUCKETS>
+class TimerPeriodicScheduler : public ExpiryAction {
+  static_assert(CAPACITY % BUCKETS == 0, "CAPACITY must be a multiple of BUCKETS");
+  static const int32_t BUCKET_CAPACITY = CAPACITY / BUCKETS;
+
+ public:
+  // 不初始化数据, resume时外层对象重新构造不会清掉已注册的实体
+  TimerPeriodicScheduler() {}
+
+  void Init() {
+    action_ = nullptr;
+    period_ = 0;
+    size_ = 0;
+    cursor_ = 0;
+    running_bucket_ = -1;
+    removed_in_run_ = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+      timer_ids_[i] = INVALID_ID;
+      counts_[i] = 0;
+    }
+    for (int32_t i = 0; i < CAPACITY; i++) {
+      slots_[i].bucket = -1;
+      slots_[i].pos = i + 1;  // 空闲时pos是空闲链表的下一个
+      slots_[i].gen = 0;
+    }
+    free_head_ = 0;
+  }
+
+  void ResumeInit() {
+    if (!action_)
+      return;
+    char* tmp = reinterpret_cast<char*>(action_);
+    tmp += CSharedMem::GetSharedMem()->GetAddrOffset();
+    action_ = reinterpret_cast<ExpiryAction*>(tmp);
+  }
+
+  // 为每个桶创建一个循环timer, 第i个桶第一次在period*(i+1)/BUCKETS后到期
+  // @action 每个实体每个周期调用一次action->OnExpiry(INVALID_ID, 实体id)
+  // @return 0=success, <0=failed, 失败时已创建的timer会被清掉
+  int Start(TimerSystemInterface& timers, ExpiryAction* action, int64_t period) {
+    if (!action || period < BUCKETS || Running())
+      return -1;
+    action_ = action;
+    period_ = period;
+    for (int i = 0; i < BUCKETS; i++) {
+      timer_ids_[i] = timers.SetTimer(this, period * (i + 1) / BUCKETS, period, i);
+      if (timer_ids_[i] == INVALID_ID) {
+        LogWarnM(LOGM_SYS, "periodic scheduler start failed, bucket:%d", i);
+        Stop(timers);
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  // 清掉桶timer, 已注册的实体保留, 可以再次Start
+  void Stop(TimerSystemInterface& timers) {
+    for (int i = 0; i < BUCKETS; i++) {
+      if (timer_ids_[i] != INVALID_ID)
+        timers.ClearTimer(timer_ids_[i]);
+      timer_ids_[i] = INVALID_ID;
+    }
+  }
+
+  bool Running() const { return timer_ids_[0] != INVALID_ID; }
+  int64_t Period() const { return period_; }
+  int32_t Size() const { return size_; }
+  int32_t BucketSize(int bucket) const { return counts_[bucket]; }
+
+  // @bucket 指定相位桶, -1表示轮流分配到下一个没满的桶
+  // @return 句柄, 满了返回-1
+  int64_t Add(int64_t entity, int bucket = -1) {
+    if (free_head_ >= CAPACITY)
+      return -1;
+    if (bucket < 0) {
+      int i = 0;
+      for (; i < BUCKETS && counts_[cursor_] >= BUCKET_CAPACITY; i++) {
+        cursor_ = (cursor_ + 1) % BUCKETS;
+      }
+      if (i == BUCKETS)
+        return -1;
+      bucket = cursor_;
+      cursor_ = (cursor_ + 1) % BUCKETS;
+    } else if (bucket >= BUCKETS || counts_[bucket] >= BUCKET_CAPACITY) {
+      return -1;
+    }
+
+    int32_t index = free_head_;
+    Slot& slot = slots_[index];
+    free_head_ = slot.pos;
+    int32_t pos = counts_[bucket]++;
+    slot.bucket = bucket;
+    slot.pos = pos;
+    entries_[bucket][pos].entity = entity;
+    entries_[bucket][pos].slot = index;
+    size_++;
+    return (static_cast<int64_t>(slot.gen) << 32) | index;
+  }
+
+  // @return 0=success, -1=句柄无效或已删除
+  int Remove(int64_t handle) {
+    Slot* slot = Find(handle);
+    if (!slot)
+      return -1;
+    int32_t index = static_cast<int32_t>(handle & 0xFFFFFFFF);
+    int bucket = slot->bucket;
+    if (bucket == running_bucket_) {
+      // 正在遍历这个桶, 只打标记, 遍历完统一压缩
+      entries_[bucket][slot->pos].slot = TIMER_PERIODIC_REMOVED;
+      removed_in_run_++;
+    } else {
+      RemoveAt(bucket, slot->pos);
+    }
+    FreeSlot(index);
+    size_--;
+    return 0;
+  }
+
+  // @return 句柄对应的实体id, 无效返回-1
+  int64_t Entity(int64_t handle) {
+    Slot* slot = Find(handle);
+    return slot ? entries_[slot->bucket][slot->pos].entity : -1;
+  }
+
+  virtual void OnExpiry(int32_t timer_globalid, int64_t user_data) override {
+    int bucket = static_cast<int>(user_data);
+    running_bucket_ = bucket;
+    removed_in_run_ = 0;
+    // 回调里新加到本桶的实体追加在末尾, 这一轮不处理.
+    // 不把桶timer的globalid交给实体, 免得实体ClearTimer把整个桶停掉
+    (void)timer_globalid;
+    int32_t count = counts_[bucket];
+    Entry* entries = entries_[bucket];
+    for (int32_t i = 0; i < count; i++) {
+      if (likely(entries[i].slot != TIMER_PERIODIC_REMOVED))
+        action_->OnExpiry(INVALID_ID, entries[i].entity);
+    }
+    running_bucket_ = -1;
+    if (removed_in_run_)
+      Compact(bucket);
+  }
+
+  virtual const char* Tag() const override { return "TimerPeriodicScheduler"; }
+
+ private:
+  struct Entry {
+    int64_t entity;
+    int32_t slot;  // 句柄表下标, TIMER_PERIODIC_REMOVED表示已删除
+  };
+  struct Slot {
+    int32_t bucket;  // -1表示空闲
+    int32_t pos;     // 桶内下标, 空闲时是空闲链表的下一个
+    uint32_t gen;    // 每次释放递增, 旧句柄失效
+  };
+
+  Slot* Find(int64_t handle) {
+    if (handle < 0)
+      return nullptr;
+    int32_t index = static_cast<int32_t>(handle & 0xFFFFFFFF);
+    if (index >= CAPACITY)
+      return nullptr;
+    Slot& slot = slots_[index];
+    if (slot.bucket < 0 || slot.gen != static_cast<uint32_t>(handle >> 32))
+      return nullptr;
+    return &slot;
+  }
+
+  void FreeSlot(int32_t index) {
+    Slot& slot = slots_[index];
+    slot.bucket = -1;
+    slot.gen++;
+    slot.pos = free_head_;
+    free_head_ = index;
+  }
+
+  // 用桶里最后一个元素填洞
+  void RemoveAt(int bucket, int32_t pos) {
+    int32_t last = --counts_[bucket];
+    if (pos != last) {
+      entries_[bucket][pos] = entries_[bucket][last];
+      slots_[entries_[bucket][pos].slot].pos = pos;
+    }
+  }
+
+  void Compact(int bucket) {
+    for (int32_t i = counts_[bucket] - 1; i >= 0; i--) {
+      if (entries_[bucket][i].slot == TIMER_PERIODIC_REMOVED)
+        RemoveAt(bucket, i);
+    }
+  }
+
+ private:
+  ExpiryAction* action_;
+  int64_t period_;
+  int32_t size_;
+  int32_t cursor_;          // 下一个自动分配的桶
+  int32_t running_bucket_;  // 正在遍历的桶, -1表示没有
+  int32_t removed_in_run_;  // 遍历期间打了删除标记的数量
+  int32_t free_head_;       // 空闲句柄链表, CAPACITY表示没有
+  int32_t timer_ids_[BUCKETS];
+  int32_t counts_[BUCKETS];
+  Slot slots_[CAPACITY];
+  Entry entries_[BUCKETS][BUCKET_CAPACITY];
+};
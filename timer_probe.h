@@ -0,0 +1,39 @@
+// @brief USDT静态探针, 线上不重新编译不重启就能用bpftrace/perf看timer的热路径
+// 有<sys/sdt.h>(systemtap-sdt-dev)时每个探针编译成一条nop和ELF note里的参数描述,
+// 没有挂探针时只有这条nop和参数的寄存器准备; 没有头文件或定义了TIMER_NO_USDT时什么都不生成.
+// 参数只用已经在寄存器/对象里的值, 不为探针额外做计算.
+//
+// provider是timer, 探针和参数:
+//   set        timer_id, action, user_data, expires          新建timer, expires是超时jiffies
+//   clear      timer_id, action, user_data, jiffies          清除, 包括组/具名/lazy cancel
+//   reset      timer_id, action, user_data, expires          ResetTimer/SetNamedTimer重置
+//   cascade    level, index, slot_size, jiffies              level为2~5, slot_size含dead timer
+//   expire     timer_id, action, user_data, jiffies, lateness  触发回调之前, lateness单位ms
+//   run_enter  jiffies, timer_jiffies, all_timers
+//   run_exit   jiffies, expired_total, all_timers            expired_total是累计触发数
+// action是ExpiryAction指针, 内联回调的timer为0. 堆后端没有cascade.
+//
+//   bpftrace -e 'usdt:./gamesvr:timer:run_enter { @t[tid] = nsecs; }
+//     usdt:./gamesvr:timer:run_exit /@t[tid]/ { @tick_us = hist((nsecs - @t[tid]) / 1000); }
+//     usdt:./gamesvr:timer:cascade { @slot = hist(arg2); }'
+//  @author justinzhu
+//  @date 2026年10月21日16:45:12
+
+#pragma once
+
+#if !defined(TIMER_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TIMER_USDT_ENABLED 1
+#endif
+#endif
+
+#ifdef TIMER_USDT_ENABLED
+#define TIMER_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(timer, name, a1, a2, a3)
+#define TIMER_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(timer, name, a1, a2, a3, a4)
+#define TIMER_PROBE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(timer, name, a1, a2, a3, a4, a5)
+#else
+#define TIMER_PROBE3(name, a1, a2, a3) ((void)0)
+#define TIMER_PROBE4(name, a1, a2, a3, a4) ((void)0)
+#define TIMER_PROBE5(name, a1, a2, a3, a4, a5) ((void)0)
+#endif
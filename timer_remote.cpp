@@ -0,0 +1,414 @@
+#include "timer_remote.h"
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+#include "lib_log.h"
+#include "lib_time_source.h"
+
+static_assert((TIMER_REMOTE_COMMANDS & (TIMER_REMOTE_COMMANDS - 1)) == 0,
+              "TIMER_REMOTE_COMMANDS must be power of 2");
+static_assert((TIMER_REMOTE_REPLIES & (TIMER_REMOTE_REPLIES - 1)) == 0,
+              "TIMER_REMOTE_REPLIES must be power of 2");
+
+void TimerCommandQueue::Init() {
+  tail = 0;
+  head = 0;
+  for (uint64_t i = 0; i < TIMER_REMOTE_COMMANDS; i++) {
+    cells[i].seq = i;
+  }
+}
+
+int TimerCommandQueue::Push(const TimerRemoteCommand& command) {
+  uint64_t pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+  for (;;) {
+    Cell& cell = cells[pos & (TIMER_REMOTE_COMMANDS - 1)];
+    uint64_t seq = __atomic_load_n(&cell.seq, __ATOMIC_ACQUIRE);
+    int64_t diff = static_cast<int64_t>(seq - pos);
+    if (diff == 0) {
+      // 槽空闲, 抢到pos之后这个槽只归自己写
+      if (__atomic_compare_exchange_n(&tail, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        cell.command = command;
+        // 写得太慢被消费者跳过时seq已经变了, 发布失败
+        uint64_t expected = pos;
+        return __atomic_compare_exchange_n(&cell.seq, &expected, pos + 1, false,
+                                           __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+                   ? 0
+                   : -1;
+      }
+    } else if (diff < 0) {
+      // 上一轮的命令还没被读走
+      return -1;
+    } else {
+      pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+int TimerCommandQueue::Pop(TimerRemoteCommand* command) {
+  Cell& cell = cells[head & (TIMER_REMOTE_COMMANDS - 1)];
+  if (__atomic_load_n(&cell.seq, __ATOMIC_ACQUIRE) != head + 1)
+    return __atomic_load_n(&tail, __ATOMIC_ACQUIRE) != head ? -2 : -1;
+  *command = cell.command;
+  // 留给下一轮同一位置的写入
+  __atomic_store_n(&cell.seq, head + TIMER_REMOTE_COMMANDS, __ATOMIC_RELEASE);
+  head++;
+  return 0;
+}
+
+int TimerCommandQueue::SkipHead() {
+  Cell& cell = cells[head & (TIMER_REMOTE_COMMANDS - 1)];
+  uint64_t expected = head;
+  if (!__atomic_compare_exchange_n(&cell.seq, &expected, head + TIMER_REMOTE_COMMANDS, false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    return -1;
+  head++;
+  return 0;
+}
+
+void TimerReplyQueue::Init() {
+  tail = 0;
+  head = 0;
+}
+
+int TimerReplyQueue::Push(const TimerRemoteReply& reply) {
+  uint64_t t = tail;
+  if (t - __atomic_load_n(&head, __ATOMIC_ACQUIRE) >= TIMER_REMOTE_REPLIES)
+    return -1;
+  replies[t & (TIMER_REMOTE_REPLIES - 1)] = reply;
+  __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+int TimerReplyQueue::Pop(TimerRemoteReply* reply) {
+  uint64_t h = head;
+  if (h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+    return -1;
+  *reply = replies[h & (TIMER_REMOTE_REPLIES - 1)];
+  __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void TimerReplyQueue::Drain() {
+  __atomic_store_n(&head, __atomic_load_n(&tail, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+void TimerRemoteShm::Init() {
+  memset(producers, 0, sizeof(producers));
+  memset(generations, 0, sizeof(generations));
+  dropped_replies = 0;
+  commands.Init();
+  for (int i = 0; i < TIMER_REMOTE_PRODUCERS; i++) {
+    replies[i].Init();
+  }
+  size = sizeof(TimerRemoteShm);
+  __atomic_store_n(&magic, TIMER_REMOTE_MAGIC, __ATOMIC_RELEASE);
+}
+
+TimerRemoteShm* TimerRemoteShm::Attach(key_t key, bool create) {
+  int id = shmget(key, sizeof(TimerRemoteShm), create ? (IPC_CREAT | 0666) : 0666);
+  if (id < 0) {
+    LogWarnM(LOGM_SYS, "timer remote shmget failed, key:%d errno:%d", key, errno);
+    return nullptr;
+  }
+  void* addr = shmat(id, nullptr, 0);
+  if (addr == reinterpret_cast<void*>(-1)) {
+    LogWarnM(LOGM_SYS, "timer remote shmat failed, key:%d errno:%d", key, errno);
+    return nullptr;
+  }
+  TimerRemoteShm* shm = static_cast<TimerRemoteShm*>(addr);
+  // 新建的段全是0, 由创建方初始化
+  if (!shm->Valid()) {
+    if (!create) {
+      LogWarnM(LOGM_SYS, "timer remote shm not initialized, key:%d", key);
+      shmdt(addr);
+      return nullptr;
+    }
+    shm->Init();
+  }
+  return shm;
+}
+
+void TimerRemoteShm::Detach(TimerRemoteShm* shm) {
+  if (shm)
+    shmdt(shm);
+}
+
+TimerRemoteClient::~TimerRemoteClient() {
+  if (shm_ && producer_ >= 0) {
+    // 队列满时发不出去, 由下一个占用这个槽的进程按generation清除
+    Submit(TIMER_REMOTE_CLEAR_ALL, 0, 0, 0, 0);
+    __atomic_store_n(&shm_->producers[producer_], 0, __ATOMIC_RELEASE);
+  }
+}
+
+int TimerRemoteClient::Init(TimerRemoteShm* shm) {
+  if (!shm || !shm->Valid())
+    return -1;
+  pid_t self = getpid();
+  for (int i = 0; i < TIMER_REMOTE_PRODUCERS; i++) {
+    pid_t owner = __atomic_load_n(&shm->producers[i], __ATOMIC_ACQUIRE);
+    // 空闲槽, 或者占用它的进程已经不在了
+    if (owner != 0 && (kill(owner, 0) == 0 || errno != ESRCH))
+      continue;
+    if (!__atomic_compare_exchange_n(&shm->producers[i], &owner, self, false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_RELAXED))
+      continue;
+    // 上一个使用者没取走的回复不再有意义
+    shm->replies[i].Drain();
+    shm_ = shm;
+    producer_ = i;
+    generation_ = __atomic_add_fetch(&shm->generations[i], 1, __ATOMIC_ACQ_REL);
+    if (generation_ == 0)
+      generation_ = __atomic_add_fetch(&shm->generations[i], 1, __ATOMIC_ACQ_REL);
+    // 上一个使用者(可能已经异常退出)留下的timer. 发不出去时服务端看到新generation也会清除
+    Submit(TIMER_REMOTE_CLEAR_ALL, 0, 0, 0, 0);
+    return 0;
+  }
+  LogWarnM(LOGM_SYS, "timer remote producers full");
+  return -1;
+}
+
+int TimerRemoteClient::Submit(int32_t op, int64_t token, int64_t expires, int64_t interval,
+                              int64_t user_data) {
+  if (!shm_)
+    return -1;
+  TimerRemoteCommand command;
+  command.op = op;
+  command.producer = producer_;
+  command.generation = generation_;
+  command.token = token;
+  int64_t now = clock_ ? clock_->NowMs() : GetRealTimeMs();
+  command.deadline = now + (expires > 0 ? expires : 0);
+  command.interval = interval;
+  command.user_data = user_data;
+  return shm_->commands.Push(command);
+}
+
+int TimerRemoteClient::SetTimer(int64_t token, int64_t expires, int64_t interval,
+                                int64_t user_data) {
+  return Submit(TIMER_REMOTE_SET, token, expires, interval, user_data);
+}
+
+int TimerRemoteClient::ResetTimer(int64_t token, int64_t expires, int64_t interval,
+                                  int64_t user_data) {
+  return Submit(TIMER_REMOTE_RESET, token, expires, interval, user_data);
+}
+
+int TimerRemoteClient::ClearTimer(int64_t token) {
+  return Submit(TIMER_REMOTE_CLEAR, token, 0, 0, 0);
+}
+
+int TimerRemoteClient::Poll(TimerRemoteReply* replies, int max_count) {
+  if (!shm_)
+    return 0;
+  int count = 0;
+  while (count < max_count && shm_->replies[producer_].Pop(&replies[count]) == 0) {
+    count++;
+  }
+  return count;
+}
+
+IMPLEMENT_IDCREATE_WITHTYPE(TimerRemoteServer, EOT_OBJ_TIMER_REMOTE_SERVER, CObj)
+
+TimerRemoteServer::TimerRemoteServer() {
+  if (SHM_MODE_INIT == get_shm_mode()) {
+    CreateInit();
+  } else {
+    ResumeInit();
+  }
+}
+
+TimerRemoteServer::~TimerRemoteServer() {
+  // 远程timer的action是本对象的成员, 不能留下来
+  if (timers_) {
+    for (int i = 0; i < TIMER_REMOTE_PRODUCERS; i++) {
+      if (groups_[i] != INVALID_ID)
+        timers_->DestroyTimerGroup(groups_[i]);
+    }
+  }
+  Detach();
+}
+
+void TimerRemoteServer::CreateInit() {
+  for (int i = 0; i < TIMER_REMOTE_PRODUCERS; i++) {
+    actions_[i].server_id_ = GetObjectID();
+    actions_[i].producer_ = i;
+  }
+  commands_ = 0;
+  failures_ = 0;
+  skipped_ = 0;
+  stuck_since_ = 0;
+  for (int i = 0; i < TIMER_REMOTE_PRODUCERS; i++) {
+    groups_[i] = INVALID_ID;
+    generations_[i] = 0;
+  }
+  timers_ = nullptr;
+  shm_ = nullptr;
+}
+
+void TimerRemoteServer::ResumeInit() {
+  timers_ = nullptr;
+  shm_ = nullptr;
+}
+
+int TimerRemoteServer::Attach(TimerSystemInterface* timers, TimerRemoteShm* shm) {
+  if (!timers || !shm || !shm->Valid())
+    return -1;
+  // 构造时obj_id可能还没分配, 这里再设置一次
+  for (int i = 0; i < TIMER_REMOTE_PRODUCERS; i++) {
+    actions_[i].server_id_ = GetObjectID();
+  }
+  timers_ = timers;
+  shm_ = shm;
+  timers_->SetRunListener(this);
+  return 0;
+}
+
+void TimerRemoteServer::Detach() {
+  if (timers_)
+    timers_->SetRunListener(nullptr);
+  timers_ = nullptr;
+  shm_ = nullptr;
+}
+
+void TimerRemoteServer::OnRunTimers(int64_t jiffies) {
+  (void)jiffies;
+  Drain();
+}
+
+int TimerRemoteServer::Drain() {
+  if (!shm_)
+    return 0;
+  int count = 0;
+  TimerRemoteCommand command;
+  for (;;) {
+    int ret = shm_->commands.Pop(&command);
+    if (ret == 0) {
+      Execute(command);
+      count++;
+      stuck_since_ = 0;
+      continue;
+    }
+    if (ret != -2)
+      break;
+    // 队头被占用但没写完, 正常情况下生产者马上就会写完, 等太久说明它已经退出
+    int64_t now = timers_->NowMs();
+    if (!stuck_since_) {
+      stuck_since_ = now;
+      break;
+    }
+    if (now - stuck_since_ < TIMER_REMOTE_PUBLISH_TIMEOUT || shm_->commands.SkipHead() != 0)
+      break;
+    LogWarnM(LOGM_SYS, "timer remote skip unpublished command, stuck:%ldms", now - stuck_since_);
+    skipped_++;
+    stuck_since_ = 0;
+  }
+  commands_ += count;
+  return count;
+}
+
+void TimerRemoteServer::Execute(const TimerRemoteCommand& command) {
+  if (command.producer < 0 || command.producer >= TIMER_REMOTE_PRODUCERS) {
+    LogWarnM(LOGM_SYS, "timer remote invalid producer:%d", command.producer);
+    return;
+  }
+  Action* action = &actions_[command.producer];
+  uint32_t& generation = generations_[command.producer];
+  if (command.generation != generation) {
+    if (generation != 0 && static_cast<int32_t>(command.generation - generation) < 0) {
+      // 已经释放槽的使用者留在队列里的命令, 回复队列也已经换了主人
+      return;
+    }
+    // 槽换了使用者, 上一个使用者的timer都不再有人认领
+    int32_t group_id = ProducerGroup(command.producer);
+    if (group_id != INVALID_ID)
+      timers_->ClearTimerGroup(group_id);
+    generation = command.generation;
+  }
+  int64_t expires = command.deadline - timers_->NowMs();
+  switch (command.op) {
+    case TIMER_REMOTE_SET: {
+      int32_t timer_id = timers_->SetNamedTimer(action, command.token, expires, command.interval,
+                                                command.user_data);
+      int32_t group_id = ProducerGroup(command.producer);
+      if (timer_id == INVALID_ID || group_id == INVALID_ID ||
+          timers_->JoinTimerGroup(timer_id, group_id) != 0) {
+        if (timer_id != INVALID_ID)
+          timers_->ClearTimer(timer_id);
+        failures_++;
+        Reply(command.producer, command.generation, TIMER_REMOTE_FAILED, INVALID_ID, command.token,
+              command.user_data);
+      }
+      break;
+    }
+    case TIMER_REMOTE_RESET: {
+      // 已存在时SetNamedTimer就是原地重设, 和SET一样不经过打散策略
+      if (timers_->FindNamedTimer(action, command.token) == INVALID_ID ||
+          timers_->SetNamedTimer(action, command.token, expires, command.interval,
+                                 command.user_data) == INVALID_ID) {
+        failures_++;
+        Reply(command.producer, command.generation, TIMER_REMOTE_FAILED, INVALID_ID, command.token,
+              command.user_data);
+      }
+      break;
+    }
+    case TIMER_REMOTE_CLEAR:
+      timers_->ClearNamedTimer(action, command.token);
+      break;
+    case TIMER_REMOTE_CLEAR_ALL: {
+      int32_t group_id = ProducerGroup(command.producer);
+      if (group_id != INVALID_ID)
+        timers_->ClearTimerGroup(group_id);
+      break;
+    }
+    default:
+      LogWarnM(LOGM_SYS, "timer remote invalid op:%d", command.op);
+      break;
+  }
+}
+
+int32_t TimerRemoteServer::ProducerGroup(int32_t producer) {
+  int32_t& group_id = groups_[producer];
+  if (group_id == INVALID_ID || timers_->TimerGroupSize(group_id) < 0)
+    group_id = timers_->CreateTimerGroup();
+  return group_id;
+}
+
+bool TimerRemoteServer::Reply(int32_t producer, uint32_t generation, int32_t type,
+                              int32_t timer_id, int64_t token, int64_t user_data) {
+  if (!shm_)
+    return false;
+  // 生产者已经退出, 没人读
+  if (__atomic_load_n(&shm_->producers[producer], __ATOMIC_ACQUIRE) == 0)
+    return false;
+  // 槽已经换了使用者, 服务端还没执行到它的CLEAR_ALL, 回复不能发给新使用者
+  if (__atomic_load_n(&shm_->generations[producer], __ATOMIC_ACQUIRE) != generation)
+    return false;
+  TimerRemoteReply reply;
+  reply.type = type;
+  reply.timer_id = timer_id;
+  reply.token = token;
+  reply.user_data = user_data;
+  if (shm_->replies[producer].Push(reply) != 0)
+    shm_->dropped_replies++;
+  return true;
+}
+
+void TimerRemoteServer::Action::OnExpiry(int32_t timer_globalid, int64_t user_data) {
+  TimerRemoteServer* server = TimerRemoteServer::GetObjectByID(server_id_);
+  if (!server || !server->timers_)
+    return;
+  Timer* timer = server->timers_->GetTimer(timer_globalid);
+  if (!timer)
+    return;
+  // 组里的timer都属于最近执行过命令的generation, 换了generation的组会先被清掉
+  if (!server->Reply(producer_, server->generations_[producer_], TIMER_REMOTE_EXPIRED,
+                     timer_globalid, timer->NameKey(), user_data)) {
+    // 没人认领了, 循环timer不用再等CLEAR_ALL
+    server->timers_->ClearTimer(timer_globalid);
+  }
+}
@@ -0,0 +1,228 @@
+// @brief 跨进程timer: 同机的辅助进程通过一段共享内存向timer所在进程提交set/reset/clear命令
+// 命令队列是多生产者单消费者的无锁环形队列(每个槽带序号), 任意辅助进程都可以并发写入;
+// timer所在进程在每次RunTimers开始时把积压的命令执行完. 每个生产者有自己的单生产者单消费者
+// 回复队列, timer到期或命令失败时写回, 辅助进程自己Poll. 不需要RPC往返.
+//
+// 辅助进程用自己选的token指代timer, 不用等timer id回来就可以reset/clear,
+// 服务端把它映射成具名timer((生产者, token) -> timer, 见SetNamedTimer).
+// 每个生产者的timer另外挂在一个timer组上. 生产者槽每被占用一次generation加1, 命令里带着它;
+// 占用和释放槽时发送CLEAR_ALL, 服务端看到generation变化时同样清掉上一个使用者的全部timer,
+// 已经释放的使用者留在队列里的旧命令直接丢弃. 异常退出的进程的timer在槽被重新占用时清除.
+// 回复同样带generation检查: 新使用者的CLEAR_ALL执行之前到期的旧timer不会回复给它.
+//
+// 生产者在抢到队列位置和写完命令之间退出时, 这个槽永远不会发布, 会堵住后面所有命令.
+// 服务端发现队头被占用却超过TIMER_REMOTE_PUBLISH_TIMEOUT毫秒没有写完时跳过它,
+// 生产者用CAS发布, 被跳过后的发布失败并返回-1. 限制: 生产者在这个窗口里只是被暂停(而不是退出),
+// 并且恢复前队列恰好绕回一整圈时, 它迟到的写入可能覆盖下一轮同一个槽里的命令.
+//
+//   // timer所在进程
+//   TimerRemoteShm* shm = TimerRemoteShm::Attach(key, true);
+//   server->Attach(&GetTimerSystem(), shm);  // server是共享内存里的TimerRemoteServer对象
+//   // 辅助进程
+//   TimerRemoteClient client;
+//   client.Init(TimerRemoteShm::Attach(key, false));
+//   client.SetTimer(token, 5000);
+//   ... client.Poll(replies, n);
+//
+// 命令里带的是绝对时间(CLOCK_REALTIME毫秒), 在队列里排队的时间不会让超时变晚.
+// 服务端按timer系统的NowMs()换算, timer系统注入了时钟时客户端用SetClock设置同一个时钟.
+//  @author justinzhu
+//  @date 2026年10月20日14:37:18
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "comm_base.h"
+#include "comm_object.h"
+#include "expiry_action.h"
+#include "timer_system_interface.h"
+
+#define TIMER_REMOTE_MAGIC (0x544D5251)      // "TMRQ"
+#define TIMER_REMOTE_PRODUCERS (16)          // 最多同时接入的辅助进程数
+#define TIMER_REMOTE_COMMANDS (4096)         // 命令队列长度, 必须是2的幂
+#define TIMER_REMOTE_REPLIES (4096)          // 每个辅助进程的回复队列长度, 必须是2的幂
+#define TIMER_REMOTE_PUBLISH_TIMEOUT (1000)  // 队头被占用但没写完超过这么多ms时跳过
+
+enum TimerRemoteOp {
+  TIMER_REMOTE_SET = 1,        // 新建, token已存在时按新参数重置
+  TIMER_REMOTE_RESET = 2,      // 只重置已存在的token, 不存在时回复失败
+  TIMER_REMOTE_CLEAR = 3,      // 清除, 不存在时忽略
+  TIMER_REMOTE_CLEAR_ALL = 4,  // 清除这个生产者槽的全部timer, 占用和释放槽时发送
+};
+
+enum TimerRemoteReplyType {
+  TIMER_REMOTE_EXPIRED = 1,  // timer到期
+  TIMER_REMOTE_FAILED = 2,   // set/reset失败, timer_id为INVALID_ID
+};
+
+struct TimerRemoteCommand {
+  int32_t op;           // TimerRemoteOp
+  int32_t producer;     // 回复队列下标
+  uint32_t generation;  // 发送时生产者槽的generation, 见TimerRemoteShm::generations
+  int64_t token;        // 生产者自己选的timer标识
+  int64_t deadline;     // 超时的绝对时间, 默认CLOCK_REALTIME毫秒, 见TimerRemoteClient::SetClock
+  int64_t interval;     // 循环间隔Milliseconds
+  int64_t user_data;    // 原样带回
+};
+
+struct TimerRemoteReply {
+  int32_t type;  // TimerRemoteReplyType
+  int32_t timer_id;
+  int64_t token;
+  int64_t user_data;
+};
+
+// 多生产者单消费者队列, 每个槽的seq表示它当前可以被哪一轮的写入/读取使用
+struct TimerCommandQueue {
+  struct Cell {
+    uint64_t seq;
+    TimerRemoteCommand command;
+  };
+
+  void Init();
+  // 任意进程并发调用
+  // @return 0=success, -1=队列满
+  int Push(const TimerRemoteCommand& command);
+  // 只有timer所在进程调用
+  // @return 0=success, -1=队列空, -2=队头已被生产者占用但还没写完
+  int Pop(TimerRemoteCommand* command);
+  // 跳过队头被占用但一直没写完的槽, 只有timer所在进程调用
+  // @return 0=已跳过, -1=队头已经写完或者为空
+  int SkipHead();
+
+  alignas(64) uint64_t tail;  // 下一个写入位置, 生产者CAS
+  alignas(64) uint64_t head;  // 下一个读取位置, 只有消费者写
+  alignas(64) Cell cells[TIMER_REMOTE_COMMANDS];
+};
+
+// 单生产者单消费者回复队列, timer所在进程写, 对应的辅助进程读
+struct TimerReplyQueue {
+  void Init();
+  // @return 0=success, -1=队列满
+  int Push(const TimerRemoteReply& reply);
+  // @return 0=success, -1=队列空
+  int Pop(TimerRemoteReply* reply);
+  // 丢弃积压的回复, 只有读端调用
+  void Drain();
+
+  alignas(64) uint64_t tail;
+  alignas(64) uint64_t head;
+  alignas(64) TimerRemoteReply replies[TIMER_REMOTE_REPLIES];
+};
+
+// 共享内存段的布局, 纯POD, 各进程映射的地址可以不同
+struct TimerRemoteShm {
+  uint32_t magic;
+  uint32_t size;
+  pid_t producers[TIMER_REMOTE_PRODUCERS];        // 占用生产者槽的进程pid, 0表示空闲
+  uint32_t generations[TIMER_REMOTE_PRODUCERS];  // 生产者槽被占用的次数, 0表示从未占用
+  int64_t dropped_replies;                       // 回复队列满丢掉的回复数
+  TimerCommandQueue commands;
+  TimerReplyQueue replies[TIMER_REMOTE_PRODUCERS];
+
+  void Init();
+  bool Valid() const { return magic == TIMER_REMOTE_MAGIC && size == sizeof(TimerRemoteShm); }
+
+  // 用SysV共享内存映射, create=true时不存在就创建并初始化
+  // @return 失败返回nullptr
+  static TimerRemoteShm* Attach(key_t key, bool create);
+  static void Detach(TimerRemoteShm* shm);
+};
+
+// 辅助进程一侧, 进程内对象
+class TimerRemoteClient {
+ public:
+  TimerRemoteClient() : shm_(nullptr), producer_(-1), generation_(0), clock_(nullptr) {}
+  // 清除自己的全部timer并释放生产者槽
+  ~TimerRemoteClient();
+
+  // 占用一个生产者槽, 进程已经退出的槽会被回收, 上一个使用者留下的timer随后被清除
+  // @return 0=success, <0=failed
+  int Init(TimerRemoteShm* shm);
+  int Producer() const { return producer_; }
+  // 计算命令里绝对时间用的时钟, 要和timer所在进程的timer系统一致, 比如同进程的TimerSimulator.
+  // nullptr表示CLOCK_REALTIME
+  void SetClock(TimerClock* clock) { clock_ = clock; }
+
+  // @expires 超时时间, 距离当前时间的Millis, 小于0的值会被修正为0
+  // @interval 循环间隔Milliseconds, 0表示非循环
+  // @return 0=success, -1=命令队列满或未初始化
+  int SetTimer(int64_t token, int64_t expires, int64_t interval = 0, int64_t user_data = 0);
+  int ResetTimer(int64_t token, int64_t expires, int64_t interval = 0, int64_t user_data = 0);
+  int ClearTimer(int64_t token);
+
+  // 取回到期通知和失败回复
+  // @return 取到的条数
+  int Poll(TimerRemoteReply* replies, int max_count);
+
+ private:
+  int Submit(int32_t op, int64_t token, int64_t expires, int64_t interval, int64_t user_data);
+
+ private:
+  TimerRemoteShm* shm_;
+  int32_t producer_;
+  uint32_t generation_;
+  TimerClock* clock_;
+};
+
+// timer所在进程一侧
+// @CObj 共享内存存储, 可恢复. 远程timer的ExpiryAction是本对象的成员, 所以本对象要和
+// 其他ExpiryAction一样放在共享内存里; 共享段指针和timers是进程内指针, resume后需要重新Attach
+class TimerRemoteServer : public CObj, public TimerRunListener {
+ public:
+  TimerRemoteServer();
+  virtual ~TimerRemoteServer();
+  void CreateInit();
+  void ResumeInit();
+
+  // 绑定timer系统和共享段, 并注册为timers的TimerRunListener
+  // @return 0=success, <0=failed
+  int Attach(TimerSystemInterface* timers, TimerRemoteShm* shm);
+  void Detach();
+
+  // 执行积压的命令, RunTimers开始时会自动调用
+  // @return 执行的命令数
+  int Drain();
+
+  virtual void OnRunTimers(int64_t jiffies) override;
+
+  int64_t Commands() { return commands_; }
+  int64_t Failures() { return failures_; }
+  // 因为生产者没写完而跳过的命令数
+  int64_t Skipped() { return skipped_; }
+
+ private:
+  // 每个生产者一个action, 作为具名timer的命名空间, 到期时写回对应的回复队列
+  class Action : public ExpiryAction {
+   public:
+    Action() {}
+    virtual void OnExpiry(int32_t timer_globalid, int64_t user_data) override;
+    virtual const char* Tag() const override { return "TimerRemote"; }
+
+    int32_t server_id_;  // 所属TimerRemoteServer的obj_id, 不存指针, resume后仍然有效
+    int32_t producer_;
+  };
+
+  void Execute(const TimerRemoteCommand& command);
+  // 生产者槽的timer组, 不存在(第一次使用, 或者换了timer系统)时新建
+  // @return 失败返回INVALID_ID
+  int32_t ProducerGroup(int32_t producer);
+  // 写回复, generation和生产者槽当前的generation不一致(槽换了使用者)时丢弃
+  // @return 写入或者队列满返回true, 没人认领的回复返回false
+  bool Reply(int32_t producer, uint32_t generation, int32_t type, int32_t timer_id, int64_t token,
+             int64_t user_data);
+
+ private:
+  Action actions_[TIMER_REMOTE_PRODUCERS];
+  int64_t commands_;                              // 执行过的命令数
+  int64_t failures_;                              // 失败的set/reset数
+  int64_t skipped_;                               // 跳过的没写完的命令数
+  int64_t stuck_since_;                           // 队头第一次发现没写完的时间, 0表示没有
+  int32_t groups_[TIMER_REMOTE_PRODUCERS];        // 每个生产者槽的timer组globalid
+  uint32_t generations_[TIMER_REMOTE_PRODUCERS];  // 每个生产者槽最近执行过的命令的generation
+  TimerSystemInterface* timers_;
+  TimerRemoteShm* shm_;
+
+  DECLARE_IDCREATE(TimerRemoteServer);
+};
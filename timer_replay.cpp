@@ -0,0 +1,258 @@
+// @brief 回放TimerSystem::EnableTrace录下的trace
+// 用一个新的时间轮按trace里的顺序重放Set/Clear/Reset/Touch/ClearAll/RunTimers,
+// 输出吞吐和超时延迟.
+//   --speed full      不sleep, 直接把时间源拨到记录的jiffies, 测纯吞吐
+//   --speed realtime  按记录的jiffies间隔sleep, 延迟按墙上时钟计算
+// cron timer按trace里记录的CronSchedule重建, 回放的时间整体平移整数周, 按分/时/周几的表达式
+// 触发点和录制时一致, 按日期/月份的会有偏差; 回放进程的time_delta按0计算.
+// SetTimerAt按录制时的相对超时重建成回放进程的逻辑时间timer.
+// trace里有多个timer系统的记录时只回放其中一个, 默认是第一条记录的系统, 其余的跳过.
+// 对象池和共享内存由comm库初始化, EOT_OBJ_TIMER的容量需要不小于trace里的live timer峰值.
+//
+// usage: timer_replay <trace file> [--speed full|realtime] [--system <system_id>]
+//  @author justinzhu
+//  @date 2026年10月19日16:05:48
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <unordered_map>
+#include "clock.h"
+#include "lib_time_source.h"
+#include "timer_system.h"
+#include "timer_trace.h"
+
+namespace {
+
+const int kLatenessBuckets = 1001;  // 0~1000ms, 最后一个桶存>=1000ms
+
+struct ReplayEnv {
+  TimerSystem* timers;
+  bool realtime;
+  int64_t trace_start;  // trace起始jiffies
+  int64_t wall_start;   // 回放开始的墙上时钟(ms)
+  int64_t now;          // 当前回放到的jiffies
+  int64_t shift;        // 回放时间轮相对trace的jiffies偏移
+  std::unordered_map<int32_t, int32_t> id_map;   // 录制id -> 回放id
+  std::unordered_map<int32_t, int32_t> rid_map;  // 回放id -> 录制id
+  int64_t fired;
+  int64_t lateness_sum;
+  int64_t lateness_max;
+  int64_t lateness_hist[kLatenessBuckets];
+};
+
+void SetNow(int64_t ms) {
+  struct timeval tv;
+  tv.tv_sec = ms / 1000;
+  tv.tv_usec = (ms % 1000) * 1000;
+  GetTimeSource().UpdateTime(&tv);
+}
+
+class ReplayAction : public ExpiryAction {
+ public:
+  explicit ReplayAction(ReplayEnv* env) : env_(env) {}
+
+  void OnExpiry(int32_t timer_globalid, int64_t user_data) override {
+    Timer* timer = env_->timers->GetTimer(timer_globalid);
+    if (!timer)
+      return;
+    int64_t expires = timer->Expires() - env_->shift;
+    int64_t lateness = env_->now - expires;
+    if (env_->realtime) {
+      int64_t wall = Clock::SystemTimeMillis() - env_->wall_start;
+      lateness = wall - (expires - env_->trace_start);
+    }
+    if (lateness < 0)
+      lateness = 0;
+    env_->fired++;
+    env_->lateness_sum += lateness;
+    if (lateness > env_->lateness_max)
+      env_->lateness_max = lateness;
+    env_->lateness_hist[lateness < kLatenessBuckets ? lateness : kLatenessBuckets - 1]++;
+
+    // 单次timer触发后就销毁了, 后续trace里对它的Clear/Reset按失败处理
+    if (timer->Interval() == 0) {
+      auto it = env_->rid_map.find(timer_globalid);
+      if (it != env_->rid_map.end()) {
+        env_->id_map.erase(it->second);
+        env_->rid_map.erase(it);
+      }
+    }
+  }
+
+ private:
+  ReplayEnv* env_;
+};
+
+int32_t MapId(ReplayEnv* env, int32_t timer_id) {
+  auto it = env->id_map.find(timer_id);
+  return it == env->id_map.end() ? INVALID_ID : it->second;
+}
+
+int64_t Percentile(const ReplayEnv& env, double ratio) {
+  int64_t target = static_cast<int64_t>(env.fired * ratio);
+  int64_t sum = 0;
+  for (int i = 0; i < kLatenessBuckets; i++) {
+    sum += env.lateness_hist[i];
+    if (sum > target)
+      return i;
+  }
+  return kLatenessBuckets - 1;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <trace file> [--speed full|realtime] [--system <system_id>]\n",
+            argv[0]);
+    return 1;
+  }
+  bool realtime = false;
+  bool has_system = false;
+  int32_t system_id = 0;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--speed") == 0) {
+      realtime = strcmp(argv[i + 1], "realtime") == 0;
+    } else if (strcmp(argv[i], "--system") == 0) {
+      has_system = true;
+      system_id = atoi(argv[i + 1]);
+    }
+  }
+
+  TimerTraceReader reader;
+  int ret = reader.Open(argv[1]);
+  if (ret != 0) {
+    fprintf(stderr, "open trace %s failed:%d\n", argv[1], ret);
+    return 1;
+  }
+
+  static ReplayEnv env;
+  env.realtime = realtime;
+  env.trace_start = reader.Header().start_jiffies;
+  env.wall_start = Clock::SystemTimeMillis();
+  env.now = env.trace_start;
+  ReplayAction action(&env);
+
+  // 时间源只能前进, 回放的jiffies整体平移到当前时间之后, 取整到周让cron的触发点对齐
+  GetTimeSource().UpdateTime();
+  const int64_t kWeekMs = 7 * 86400 * SECOND_MS;
+  int64_t shift = (GetRealTickTimeMs() - env.trace_start + kWeekMs - 1) / kWeekMs * kWeekMs;
+  env.shift = shift;
+  SetNow(env.trace_start + shift);
+  env.timers = dynamic_cast<TimerSystem*>(TimerSystem::CreateObject());
+  env.timers->Init(env.trace_start + shift);
+
+  int64_t ops[TIMER_TRACE_OP_MAX] = {};
+  int64_t tick_ns = 0;
+  int64_t op_ns = 0;
+  int64_t records = 0;
+  int64_t skipped = 0;
+  int64_t start = Clock::GetNowTickCount();
+  TimerTraceRecord record;
+  while (reader.Next(&record)) {
+    if (!has_system) {
+      has_system = true;
+      system_id = record.system_id;
+    }
+    // 别的系统的timer id和tick都不能混进来, 否则时间轮会被多推进几次
+    if (record.system_id != system_id) {
+      skipped++;
+      continue;
+    }
+    records++;
+    if (realtime) {
+      int64_t wait =
+          (record.jiffies - env.trace_start) - (Clock::SystemTimeMillis() - env.wall_start);
+      if (wait > 0)
+        usleep(wait * 1000);
+    }
+    if (record.jiffies > env.now) {
+      env.now = record.jiffies;
+      SetNow(env.now + shift);
+    }
+
+    int64_t op_start = Clock::GetNowTickCount();
+    switch (record.op) {
+      case TIMER_TRACE_SET: {
+        int32_t id = env.timers->SetTimer(&action, record.expires, record.interval,
+                                          record.user_data);
+        if (id != INVALID_ID) {
+          env.id_map[record.timer_id] = id;
+          env.rid_map[id] = record.timer_id;
+        }
+        break;
+      }
+      case TIMER_TRACE_SET_AT: {
+        int64_t logic_ms = env.timers->NowMs() + GetTimeDelta() * SECOND_MS + record.expires;
+        int32_t id = env.timers->SetTimerAt(&action, logic_ms, record.interval, record.user_data);
+        if (id != INVALID_ID) {
+          env.id_map[record.timer_id] = id;
+          env.rid_map[id] = record.timer_id;
+        }
+        break;
+      }
+      case TIMER_TRACE_CRON: {
+        int32_t id = env.timers->SetCronTimer(&action, record.cron, record.user_data);
+        if (id != INVALID_ID) {
+          env.id_map[record.timer_id] = id;
+          env.rid_map[id] = record.timer_id;
+        }
+        break;
+      }
+      case TIMER_TRACE_CLEAR: {
+        int32_t id = MapId(&env, record.timer_id);
+        env.timers->ClearTimer(id);
+        env.id_map.erase(record.timer_id);
+        env.rid_map.erase(id);
+        break;
+      }
+      case TIMER_TRACE_RESET:
+        env.timers->ResetTimer(MapId(&env, record.timer_id), &action, record.expires,
+                               record.interval, record.user_data);
+        break;
+      case TIMER_TRACE_TOUCH:
+        env.timers->TouchTimer(MapId(&env, record.timer_id), record.expires);
+        break;
+      case TIMER_TRACE_TICK:
+        env.timers->RunTimers(record.jiffies + shift);
+        break;
+      case TIMER_TRACE_CLEAR_ALL:
+        env.timers->ClearAll();
+        env.id_map.clear();
+        env.rid_map.clear();
+        break;
+      default:
+        break;
+    }
+    int64_t cost = Clock::GetNowTickCount() - op_start;
+    if (record.op == TIMER_TRACE_TICK) {
+      tick_ns += cost;
+    } else {
+      op_ns += cost;
+    }
+    ops[record.op]++;
+  }
+  int64_t elapsed = Clock::GetNowTickCount() - start;
+
+  printf("system:%d records:%ld skipped:%ld elapsed:%.3fs throughput:%.0f records/s "
+         "trace span:%.3fs\n",
+         system_id, records, skipped, elapsed / 1e9, records * 1e9 / (elapsed ? elapsed : 1),
+         (env.now - env.trace_start) / 1e3);
+  printf("set:%ld set_at:%ld cron:%ld clear:%ld reset:%ld touch:%ld clear_all:%ld tick:%ld\n",
+         ops[TIMER_TRACE_SET], ops[TIMER_TRACE_SET_AT], ops[TIMER_TRACE_CRON],
+         ops[TIMER_TRACE_CLEAR], ops[TIMER_TRACE_RESET], ops[TIMER_TRACE_TOUCH],
+         ops[TIMER_TRACE_CLEAR_ALL], ops[TIMER_TRACE_TICK]);
+  int64_t mutations = ops[TIMER_TRACE_SET] + ops[TIMER_TRACE_SET_AT] + ops[TIMER_TRACE_CRON] +
+                      ops[TIMER_TRACE_CLEAR] + ops[TIMER_TRACE_RESET] + ops[TIMER_TRACE_TOUCH];
+  printf("mutation:%.1f ns/op RunTimers:%.1f ns/tick\n",
+         mutations ? static_cast<double>(op_ns) / mutations : 0.0,
+         ops[TIMER_TRACE_TICK] ? static_cast<double>(tick_ns) / ops[TIMER_TRACE_TICK] : 0.0);
+  printf("fired:%ld lateness avg:%.2fms p50:%ldms p99:%ldms max:%ldms live:%ld\n", env.fired,
+         env.fired ? static_cast<double>(env.lateness_sum) / env.fired : 0.0,
+         Percentile(env, 0.5), Percentile(env, 0.99), env.lateness_max,
+         env.timers->AllTimers());
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include "timer_simulator.h"
+#include <algorithm>
+
+TimerSimulator::~TimerSimulator() {
+  for (TimerSystemInterface* timers : timers_) {
+    timers->SetClock(nullptr);
+  }
+}
+
+int TimerSimulator::Attach(TimerSystemInterface* timers) {
+  if (!timers || std::find(timers_.begin(), timers_.end(), timers) != timers_.end())
+    return -1;
+  timers->SetClock(&clock_);
+  timers_.push_back(timers);
+  return 0;
+}
+
+void TimerSimulator::Detach(TimerSystemInterface* timers) {
+  auto it = std::find(timers_.begin(), timers_.end(), timers);
+  if (it == timers_.end())
+    return;
+  timers->SetClock(nullptr);
+  timers_.erase(it);
+}
+
+int64_t TimerSimulator::Step(int64_t end_ms) {
+  int64_t next = -1;
+  for (TimerSystemInterface* timers : timers_) {
+    int64_t expiry = timers->NextExpiry();
+    if (expiry >= 0 && (next < 0 || expiry < next))
+      next = expiry;
+  }
+  if (next < 0 || next > end_ms) {
+    clock_.Set(end_ms);
+    return -1;
+  }
+  // 推迟的timer(执行预算)会让NextExpiry不晚于当前时间, 在当前时间再跑一轮
+  clock_.Set(next);
+  int64_t now = clock_.NowMs();
+  for (TimerSystemInterface* timers : timers_) {
+    timers->RunTimers(now);
+  }
+  steps_++;
+  return now;
+}
+
+int64_t TimerSimulator::RunUntil(int64_t end_ms) {
+  int64_t steps = 0;
+  while (Step(end_ms) >= 0) {
+    steps++;
+  }
+  return steps;
+}
@@ -0,0 +1,69 @@
+// @brief 离散事件模拟: 用虚拟时钟驱动一个或多个timer系统, 不等真实时间
+// 每一步把虚拟时间直接拨到所有timer系统里最早的NextExpiry, 再对它们执行RunTimers,
+// 回调以最快速度依次执行. 一周的经济系统模拟只取决于回调本身的耗时.
+// 每个模拟器有自己的时钟, 同一进程里可以同时跑多个互不相干的模拟.
+//
+//   TimerSimulator sim(start_ms);
+//   TimerSystemInterface* timers = CreateTimerSystem(TIMER_BACKEND_WHEEL, start_ms);
+//   sim.Attach(timers);
+//   timers->SetTimer(&action, {Hour(1)}, {Hour(1)});
+//   sim.RunFor(int64_t(WEEK_SECOND) * SECOND_MS);
+//
+// 回调里要取当前时间时用timers->NowMs()或sim.Clock()->NowMs(), 不要用GetRealTickTimeMs().
+// 逻辑时间timer(SetTimerAt)的时间偏移仍然取全局的CTimeSource.
+//  @author justinzhu
+//  @date 2026年10月21日10:26:47
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "timer_system_interface.h"
+
+// 只在Set/Advance时前进的时钟
+class VirtualTimerClock : public TimerClock {
+ public:
+  explicit VirtualTimerClock(int64_t now_ms) : now_(now_ms) {}
+
+  virtual int64_t NowMs() override { return now_; }
+  // 时间不会倒退, 早于当前的值忽略
+  void Set(int64_t now_ms) {
+    if (now_ms > now_)
+      now_ = now_ms;
+  }
+  void Advance(int64_t ms) { Set(now_ + ms); }
+
+ private:
+  int64_t now_;
+};
+
+// 进程内对象, 不放共享内存
+class TimerSimulator {
+ public:
+  explicit TimerSimulator(int64_t start_ms) : clock_(start_ms), steps_(0) {}
+  ~TimerSimulator();
+
+  VirtualTimerClock* Clock() { return &clock_; }
+  int64_t NowMs() { return clock_.NowMs(); }
+  // 实际执行RunTimers的轮数
+  int64_t Steps() const { return steps_; }
+
+  // 给timers注入本模拟器的时钟, timers应该用start_ms或之后的时间Init
+  // @return 0=success, <0=failed
+  int Attach(TimerSystemInterface* timers);
+  // 恢复timers的默认时钟
+  void Detach(TimerSystemInterface* timers);
+
+  // 时间拨到下一个到期点(不超过end_ms)并执行一轮RunTimers
+  // @return 本轮的时间点, 到end_ms之前都没有timer到期时时钟停在end_ms并返回-1
+  int64_t Step(int64_t end_ms);
+  // 一直执行到end_ms, 时钟停在end_ms. end_ms这一刻到期的timer也会触发
+  // @return 执行的轮数
+  int64_t RunUntil(int64_t end_ms);
+  int64_t RunFor(int64_t ms) { return RunUntil(NowMs() + ms); }
+
+ private:
+  VirtualTimerClock clock_;
+  int64_t steps_;
+  std::vector<TimerSystemInterface*> timers_;
+};
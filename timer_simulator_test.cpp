@@ -0,0 +1,149 @@
+// @brief 模拟器自检: 用虚拟时钟驱动时间轮和堆两种timer系统, 检查:
+//   1. 一周的每小时timer按虚拟时间准点触发, 回调里的NowMs()就是到期时间, 不等真实时间
+//   2. 同一个模拟器上的多个timer系统按时间先后交替触发
+//   3. 跨进程timer的服务端按timer系统的时钟换算命令里的绝对时间
+// 对象池和共享内存由comm库初始化, 和timer_bench一样.
+//
+// usage: timer_simulator_test
+// @return 0=全部通过, 1=有失败
+//  @author justinzhu
+//  @date 2026年10月24日16:05:37
+
+#include <stdio.h>
+#include <sys/shm.h>
+#include "lib_time_source.h"
+#include "timer_remote.h"
+#include "timer_simulator.h"
+
+namespace {
+
+int g_failed = 0;
+
+#define EXPECT(cond, ...)                          \
+  do {                                             \
+    if (!(cond)) {                                 \
+      printf("FAILED %s:%d ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                         \
+      printf("\n");                                \
+      g_failed++;                                  \
+    }                                              \
+  } while (0)
+
+// 虚拟时间和真实时间差得足够远, 误用真实时间的地方会算出离谱的超时
+const int64_t kStartMs = 1000LL * 86400 * SECOND_MS;
+const int64_t kHourMs = 3600LL * SECOND_MS;
+
+// 检查每次触发的虚拟时间, next是下一次期望的到期时间
+class StepAction : public ExpiryAction {
+ public:
+  StepAction(TimerSystemInterface* timers, int64_t first, int64_t interval, int64_t* last)
+      : timers_(timers), next_(first), interval_(interval), last_(last) {}
+  virtual void OnExpiry(int32_t timer_globalid, int64_t user_data) override {
+    int64_t now = timers_->NowMs();
+    if (now != next_)
+      wrong_++;
+    // 多个timer系统共用一个last, 触发时间不能倒退
+    if (last_ && now < *last_)
+      backward_++;
+    if (last_)
+      *last_ = now;
+    next_ += interval_;
+    fired_++;
+  }
+
+  int fired_ = 0;
+  int wrong_ = 0;
+  int backward_ = 0;
+
+ private:
+  TimerSystemInterface* timers_;
+  int64_t next_;
+  int64_t interval_;
+  int64_t* last_;
+};
+
+void TestWeek(TimerBackend backend) {
+  const char* engine = backend == TIMER_BACKEND_HEAP ? "heap" : "wheel";
+  TimerSimulator sim(kStartMs);
+  TimerSystemInterface* timers = CreateTimerSystem(backend, kStartMs);
+  EXPECT(timers != nullptr, "%s CreateTimerSystem", engine);
+  if (!timers)
+    return;
+  sim.Attach(timers);
+  StepAction hourly(timers, kStartMs + kHourMs, kHourMs, nullptr);
+  timers->SetTimer(&hourly, kHourMs, kHourMs);
+  int64_t steps = sim.RunFor(7 * 24 * kHourMs);
+  EXPECT(hourly.fired_ == 7 * 24, "%s fired:%d", engine, hourly.fired_);
+  EXPECT(hourly.wrong_ == 0, "%s wrong time:%d", engine, hourly.wrong_);
+  // 时间轮高层槽的NextExpiry只是下界, 会多停几次, 但远少于按毫秒推进
+  EXPECT(steps >= 7 * 24 && steps <= 7 * 24 * 8, "%s steps:%ld", engine, steps);
+  EXPECT(sim.NowMs() == kStartMs + 7 * 24 * kHourMs, "%s now:%ld", engine, sim.NowMs());
+  sim.Detach(timers);
+}
+
+void TestInterleave() {
+  TimerSimulator sim(kStartMs);
+  TimerSystemInterface* wheel = CreateTimerSystem(TIMER_BACKEND_WHEEL, kStartMs);
+  TimerSystemInterface* heap = CreateTimerSystem(TIMER_BACKEND_HEAP, kStartMs);
+  EXPECT(wheel && heap, "CreateTimerSystem");
+  if (!wheel || !heap)
+    return;
+  sim.Attach(wheel);
+  sim.Attach(heap);
+  int64_t last = 0;
+  StepAction fast(wheel, kStartMs + 70, 70, &last);
+  StepAction slow(heap, kStartMs + 110, 110, &last);
+  wheel->SetTimer(&fast, 70, 70);
+  heap->SetTimer(&slow, 110, 110);
+  sim.RunFor(7700);
+  EXPECT(fast.fired_ == 110 && slow.fired_ == 70, "fired:%d/%d", fast.fired_, slow.fired_);
+  EXPECT(fast.wrong_ == 0 && slow.wrong_ == 0, "wrong time:%d/%d", fast.wrong_, slow.wrong_);
+  EXPECT(fast.backward_ == 0 && slow.backward_ == 0, "backward:%d/%d", fast.backward_,
+         slow.backward_);
+}
+
+void TestRemote() {
+  const key_t key = 0x544D5354;
+  TimerRemoteShm* shm = TimerRemoteShm::Attach(key, true);
+  EXPECT(shm != nullptr, "TimerRemoteShm::Attach");
+  if (!shm)
+    return;
+  shm->Init();
+  TimerSimulator sim(kStartMs);
+  TimerSystemInterface* timers = CreateTimerSystem(TIMER_BACKEND_WHEEL, kStartMs);
+  TimerRemoteServer* server = dynamic_cast<TimerRemoteServer*>(TimerRemoteServer::CreateObject());
+  EXPECT(timers && server, "create remote server");
+  if (timers && server) {
+    sim.Attach(timers);
+    server->Attach(timers, shm);
+    TimerRemoteClient client;
+    client.SetClock(sim.Clock());
+    EXPECT(client.Init(shm) == 0, "client Init");
+    client.SetTimer(1, 5000);
+    // 没有timer时模拟器不会执行RunTimers, 手动收一次命令
+    server->Drain();
+    TimerRemoteReply replies[4];
+    sim.RunUntil(kStartMs + 4999);
+    EXPECT(client.Poll(replies, 4) == 0, "remote timer fired early");
+    sim.RunUntil(kStartMs + 5000);
+    int count = client.Poll(replies, 4);
+    EXPECT(count == 1 && replies[0].type == TIMER_REMOTE_EXPIRED && replies[0].token == 1,
+           "remote replies:%d", count);
+    server->Detach();
+    sim.Detach(timers);
+  }
+  TimerRemoteShm::Detach(shm);
+  shmctl(shmget(key, 0, 0), IPC_RMID, nullptr);
+}
+
+}  // namespace
+
+int main() {
+  GetTimeSource().UpdateTime();
+  TestWeek(TIMER_BACKEND_WHEEL);
+  TestWeek(TIMER_BACKEND_HEAP);
+  TestInterleave();
+  TestRemote();
+  printf("%s\n", g_failed ? "FAILED" : "PASSED");
+  return g_failed ? 1 : 0;
+}
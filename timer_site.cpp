@@ -0,0 +1,71 @@
+#include "timer_site.h"
+#include <algorithm>
+#include "lib_log.h"
+
+TimerSite::TimerSite(const char* name) : name_(name), id_(GetTimerSiteRegistry().Register(name)) {}
+
+TimerSiteRegistry::TimerSiteRegistry() {
+  memset(entries_, 0, sizeof(entries_));
+  size_ = 0;
+}
+
+uint32_t TimerSiteRegistry::Register(const char* name) {
+  // FNV-1a, 同一份二进制里名字是稳定的
+  uint32_t id = 2166136261u;
+  for (const char* p = name; *p; p++) {
+    id = (id ^ static_cast<uint8_t>(*p)) * 16777619u;
+  }
+  if (!id)
+    id = 1;
+
+  for (int i = 0; i < TIMER_SITE_CAPACITY; i++) {
+    Entry* entry = &entries_[(id + i) & (TIMER_SITE_CAPACITY - 1)];
+    if (!entry->id) {
+      entry->id = id;
+      entry->name = name;
+      size_++;
+      return id;
+    }
+    if (entry->id == id) {
+      // 统计用途, 冲突不影响timer本身, 不需要像回调那样abort
+      if (strcmp(entry->name, name) != 0)
+        LogWarnM(LOGM_SYS, "timer site id conflict:%u, %s vs %s", id, entry->name, name);
+      return id;
+    }
+  }
+  // 名字表满了也照样返回id, 报告里只显示id
+  LogWarnM(LOGM_SYS, "timer site registry full, size:%d, site:%s", size_, name);
+  return id;
+}
+
+const char* TimerSiteRegistry::Find(uint32_t id) const {
+  for (int i = 0; i < TIMER_SITE_CAPACITY; i++) {
+    const Entry* entry = &entries_[(id + i) & (TIMER_SITE_CAPACITY - 1)];
+    if (entry->id == id)
+      return entry->name;
+    if (!entry->id)
+      break;
+  }
+  return nullptr;
+}
+
+void TimerSiteTable::TopN(int top_n, std::vector<TimerSiteStat>* out) const {
+  out->clear();
+  for (int32_t i = 0; i < TIMER_SITE_CAPACITY; i++) {
+    const Entry& entry = entries_[i];
+    if (!entry.id)
+      continue;
+    TimerSiteStat stat;
+    stat.site_id = entry.id;
+    stat.name = GetTimerSiteRegistry().Find(entry.id);
+    stat.live = entry.live;
+    stat.created = entry.created;
+    stat.cleared = entry.cleared;
+    out->push_back(stat);
+  }
+  std::sort(out->begin(), out->end(), [](const TimerSiteStat& a, const TimerSiteStat& b) {
+    return a.live != b.live ? a.live > b.live : a.created > b.created;
+  });
+  if (top_n >= 0 && out->size() > static_cast<size_t>(top_n))
+    out->resize(top_n);
+}
@@ -0,0 +1,153 @@
+// @brief timer创建位置统计: 找出是哪段代码留下了大量timer(泄漏)或者频繁创建/取消(抖动)
+// SetTimer时传入TimerSite, site的id记在Timer里(对齐空隙, 不增加大小), 每个timer系统按site
+// 累计live/created/cleared. 没有传site的timer不统计, 热路径上只多一次判0.
+// site id是名字的FNV-1a hash, 和内联回调的id一样在resume后的新进程里不变; 统计表是POD,
+// 放在timer系统的共享内存里, resume后live仍然准确. 名字是进程内指针, 只存在TimerSiteRegistry里.
+//
+//   timers->SetTimer(TIMER_HERE(), this, Sec(5));            // 按"文件:行号"统计
+//   static const TimerSite kLoginSite("login_timeout");       // 或者调用方给一个静态tag
+//   timers->SetTimer(kLoginSite, this, Sec(5));
+//   LogInfo("%s", timers->TimerSiteReport(20).c_str());
+//  @author justinzhu
+//  @date 2026年10月21日19:32:08
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "singleton.h"
+#include "timer_defines.h"
+
+// 一个创建位置, 一般是静态对象, 构造时注册名字
+class TimerSite {
+ public:
+  // @name 生命周期要覆盖整个进程, 一般是字符串字面量
+  explicit TimerSite(const char* name);
+
+  const char* Name() const { return name_; }
+  uint32_t ID() const { return id_; }
+
+ private:
+  const char* name_;
+  uint32_t id_;
+};
+
+#define TIMER_SITE_STR_(x) #x
+#define TIMER_SITE_STR(x) TIMER_SITE_STR_(x)
+// 当前的"文件:行号", 每个调用点一个静态TimerSite, 只有第一次执行时注册
+#define TIMER_HERE()                                                          \
+  ([]() -> const TimerSite& {                                                 \
+    static const TimerSite timer_site(__FILE__ ":" TIMER_SITE_STR(__LINE__)); \
+    return timer_site;                                                        \
+  }())
+
+// site id -> 名字, 进程内对象, 不放共享内存
+class TimerSiteRegistry {
+ public:
+  TimerSiteRegistry();
+
+  // @return site id, 非0. 不同名字hash冲突时告警并共用一个id, 统计会合并
+  uint32_t Register(const char* name);
+
+  // @return 没注册过返回nullptr, 比如resume后还没执行到的TIMER_HERE
+  const char* Find(uint32_t id) const;
+
+ private:
+  struct Entry {
+    uint32_t id;
+    const char* name;
+  };
+  Entry entries_[TIMER_SITE_CAPACITY];
+  int32_t size_;
+};
+
+inline TimerSiteRegistry& GetTimerSiteRegistry() {
+  return Singleton<TimerSiteRegistry>::GetInstance();
+}
+
+// 单个创建位置的统计
+struct TimerSiteStat {
+  uint32_t site_id;
+  const char* name;  // 进程里还没注册时为nullptr
+  int64_t live;      // 当前存活的timer数, 包括ClearAll之后还没回收的
+  int64_t created;   // ResetCounters之后创建的timer数
+  int64_t cleared;   // ResetCounters之后被ClearTimer/ClearTimerGroup等主动清除的数
+};
+
+// 按site id计数的开放寻址表, 纯POD数据, 和TimerNameIndex一样直接放在共享内存的对象里.
+// site一旦出现就不删除, 表满后新site的timer不统计, 计入Dropped
+class TimerSiteTable {
+ public:
+  void Clear(int64_t now_ms) {
+    memset(entries_, 0, sizeof(entries_));
+    size_ = 0;
+    dropped_ = 0;
+    since_ms_ = now_ms;
+  }
+
+  // created/cleared清零, 从now_ms开始重新计算速率, live保留
+  void ResetCounters(int64_t now_ms) {
+    for (int32_t i = 0; i < TIMER_SITE_CAPACITY; i++) {
+      entries_[i].created = 0;
+      entries_[i].cleared = 0;
+    }
+    dropped_ = 0;
+    since_ms_ = now_ms;
+  }
+
+  void OnCreate(uint32_t site_id) {
+    Entry* entry = Find(site_id, true);
+    if (!entry) {
+      dropped_++;
+      return;
+    }
+    entry->live++;
+    entry->created++;
+  }
+  void OnClear(uint32_t site_id) {
+    if (Entry* entry = Find(site_id, false))
+      entry->cleared++;
+  }
+  // timer回到对象池或slab
+  void OnRelease(uint32_t site_id) {
+    if (Entry* entry = Find(site_id, false))
+      entry->live--;
+  }
+
+  int32_t Size() const { return size_; }
+  // 表满后没有统计的创建次数
+  int64_t Dropped() const { return dropped_; }
+  int64_t SinceMs() const { return since_ms_; }
+
+  // 按live倒序取前top_n个, live相同按created倒序
+  void TopN(int top_n, std::vector<TimerSiteStat>* out) const;
+
+ private:
+  struct Entry {
+    uint32_t id;  // 0表示空槽
+    int64_t live;
+    int64_t created;
+    int64_t cleared;
+  };
+
+  Entry* Find(uint32_t site_id, bool insert) {
+    for (uint32_t i = site_id;; i++) {
+      Entry* entry = &entries_[i & (TIMER_SITE_CAPACITY - 1)];
+      if (entry->id == site_id)
+        return entry;
+      if (entry->id)
+        continue;
+      if (!insert || size_ >= TIMER_SITE_CAPACITY / 4 * 3)
+        return nullptr;
+      entry->id = site_id;
+      size_++;
+      return entry;
+    }
+  }
+
+  Entry entries_[TIMER_SITE_CAPACITY];
+  int32_t size_;
+  int64_t dropped_;
+  int64_t since_ms_;
+};
@@ -1,7 +1,14 @@
 #include "timer_system.h"
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "expiry_profiler.h"
 #include "lib_log.h"
 #include "lib_time_source.h"
 #include "linux_like_bitops.h"
+#include "timer_group.h"
+#include "timer_probe.h"
+#include "timer_trace.h"
 
 IMPLEMENT_IDCREATE_WITHTYPE(TimerSystem, EOT_OBJ_TIMER_SYSTEM, CObj)
 
@@ -19,6 +26,30 @@ void TimerSystem::CreateInit() {
   memset(&tv3_, -1, sizeof(tv3_));
   memset(&tv4_, -1, sizeof(tv4_));
   memset(&tv5_, -1, sizeof(tv5_));
+  overflow_.Clear();
+  names_.Clear();
+  memset(&stats_, 0, sizeof(stats_));
+  trace_ = false;
+  lazy_cancel_ = false;
+  dead_timers_ = 0;
+  time_delta_ = GetTimeDelta();
+  logic_timers_ = 0;
+  logic_list_ = INVALID_ID;
+  running_ = false;
+  memset(&spread_, 0, sizeof(spread_));
+  sites_.Clear(0);
+  priority_dispatch_ = false;
+  expiry_budget_ = 0;
+  budget_left_ = 0;
+  memset(priority_lists_, -1, sizeof(priority_lists_));
+  memset(deferred_lists_, -1, sizeof(deferred_lists_));
+  epoch_ = 0;
+  stale_timers_ = 0;
+  stale_list_ = INVALID_ID;
+  work_list_ = INVALID_ID;
+  memset(&slab_, 0, sizeof(slab_));
+  free_list_ = INVALID_ID;
+  encode_ids_ = false;
 }
 
 TimerSystem::~TimerSystem() {
@@ -37,11 +68,29 @@ TimerSystem::~TimerSystem() {
     if (tv1_.vec[j] >= 0)
       CIDRuntimeClass::DestroyObj(Timer::GetObjectByID(tv1_.vec[j]));
   }
+  while (!overflow_.Empty()) {
+    CIDRuntimeClass::DestroyObj(overflow_.Pop());
+  }
+  for (j = 0; j < TIMER_PRIORITY_CLASSES; j++) {
+    if (priority_lists_[j] >= 0)
+      CIDRuntimeClass::DestroyObj(Timer::GetObjectByID(priority_lists_[j]));
+    if (deferred_lists_[j] >= 0)
+      CIDRuntimeClass::DestroyObj(Timer::GetObjectByID(deferred_lists_[j]));
+  }
+  if (stale_list_ >= 0)
+    CIDRuntimeClass::DestroyObj(Timer::GetObjectByID(stale_list_));
+  if (work_list_ >= 0)
+    CIDRuntimeClass::DestroyObj(Timer::GetObjectByID(work_list_));
+  if (free_list_ >= 0) {
+    SetTimerSlabCapacity(0);
+    CIDRuntimeClass::DestroyObj(Timer::GetObjectByID(free_list_));
+  }
   printf("TimerSystem destory\n");
 }
 
 int TimerSystem::Init(int64_t jiffies) {
   int j;
+  sites_.ResetCounters(jiffies);  // 创建位置的速率从Init开始算
   for (j = 0; j < TVN_SIZE; j++) {
     tv5_.vec[j] = Timer::CreateInitListHead()->GetObjectID();
     tv4_.vec[j] = Timer::CreateInitListHead()->GetObjectID();
@@ -51,6 +100,13 @@ int TimerSystem::Init(int64_t jiffies) {
   for (j = 0; j < TVR_SIZE; j++) {
     tv1_.vec[j] = Timer::CreateInitListHead()->GetObjectID();
   }
+  for (j = 0; j < TIMER_PRIORITY_CLASSES; j++) {
+    priority_lists_[j] = Timer::CreateInitListHead()->GetObjectID();
+    deferred_lists_[j] = Timer::CreateInitListHead()->GetObjectID();
+  }
+  stale_list_ = Timer::CreateInitListHead()->GetObjectID();
+  work_list_ = Timer::CreateInitListHead()->GetObjectID();
+  free_list_ = Timer::CreateInitListHead()->GetObjectID();
 
   timer_jiffies_ = jiffies;
   next_timer_ = timer_jiffies_;
@@ -82,10 +138,17 @@ void TimerSystem::DoInternalAddTimer(Timer *timer) {
     vec = tv1_.vec[(timer_jiffies_ & TVR_MASK)];
   } else {
     int i;
-    // If the timeout is larger than MAX_TVAL (on 64-bit
-    // architectures or with CONFIG_BASE_SMALL=1) then we
-    // use the maximum timeout.
+    // If the timeout is larger than MAX_TVAL keep the timer in the
+    // overflow heap until it enters the wheel range, see
+    // MigrateOverflowTimers(). Only when the heap is full we fall
+    // back to the maximum timeout like Linux does.
     if (idx > MAX_TVAL) {
+      // ModTimer摘链时不清Next(), 进堆前清掉, 否则堆里的timer仍然TimerPending()
+      timer->SetNext(LIST_POISON);
+      if (overflow_.Push(timer) == 0)
+        return;
+      LogWarnM(LOGM_SYS, "timer overflow heap full, clamp expires:%ld to MAX_TVAL",
+               timer->Expires());
       idx = MAX_TVAL;
       expires = idx + timer_jiffies_;
     }
@@ -112,13 +175,18 @@ void TimerSystem::InternalAddTimer(Timer *timer, int64_t jiffies) {
   if (!active_timers_++ || timer->Expires() < next_timer_)
     next_timer_ = timer->Expires();
   all_timers_++;
+  if (unlikely(arm_listener_ != nullptr))
+    arm_listener_->OnTimerArmed(timer->Expires());
 }
 
 int TimerSystem::DetachIfPending(Timer *timer, bool clear_pending, int64_t jiffies) {
-  if (!timer->TimerPending())
+  if (timer->InHeap()) {
+    overflow_.Remove(timer);
+  } else if (!timer->TimerPending()) {
     return 0;
-
-  timer->DetachTimer(clear_pending);
+  } else {
+    timer->DetachTimer(clear_pending);
+  }
   active_timers_--;
   if (timer->Expires() == next_timer_)
     next_timer_ = timer_jiffies_;
@@ -136,6 +204,7 @@ int TimerSystem::InternalModTimer(Timer *timer, int64_t jiffies, int64_t expires
     return ret;
 
   timer->SetExpires(expires);
+  timer->SetDeferredExpires(0);
   InternalAddTimer(timer, jiffies);
 
   // printf("InternalModTimer:%s\n", timer->DebugString().c_str());
@@ -186,7 +255,7 @@ int TimerSystem::ModTimer(Timer *timer, int64_t jiffies, int64_t expires) {
 // Timers with an ->expires field in the past will be executed in the next
 // timer tick.
 void TimerSystem::AddTimer(Timer *timer, int64_t jiffies) {
-  assert(!timer->TimerPending());
+  assert(!timer->TimerPending() && !timer->InHeap());
   ModTimer(timer, jiffies, timer->Expires());
 }
 
@@ -200,7 +269,7 @@ void TimerSystem::AddTimer(Timer *timer, int64_t jiffies) {
 int TimerSystem::DelTimer(Timer *timer, int64_t jiffies) {
   int ret = 0;
 
-  if (timer->TimerPending()) {
+  if (timer->TimerPending() || timer->InHeap()) {
     ret = DetachIfPending(timer, true, jiffies);
   }
 
@@ -215,10 +284,30 @@ void TimerSystem::DetachExpiredTimer(Timer *timer, int64_t jiffies) {
   CatchupTimerJiffies(jiffies);
 }
 
+// 打散timer要进的tv1槽已经接收了slot_cap个时, 顺延到本次cascade范围内下一个没满的槽,
+// 都满了就留在原槽
+void TimerSystem::CapSpreadTimer(Timer *timer, int32_t *slot_counts) {
+  int64_t end = ((timer->Expires() >> TVR_BITS) + 1) << TVR_BITS;
+  for (int64_t expires = timer->Expires(); expires < end; expires++) {
+    if (slot_counts[expires & TVR_MASK] < spread_.slot_cap) {
+      if (expires != timer->Expires()) {
+        timer->SetExpires(expires);
+        stats_.spread_shifted++;
+      }
+      return;
+    }
+  }
+}
+
 int TimerSystem::Cascade(struct tvec *tv, int index) {
   // Cascade all the timers from tv up one level
   // Timer *tv_list = Timer::CreateInitListHead();
   Timer *tv_list = Timer::CreateInitListHead();
+  // tv2的一个槽正好展开成tv1的一整圈, 统计每个tv1槽这次接收了多少timer
+  int32_t slot_counts[TVR_SIZE];
+  bool cap = unlikely(spread_.slot_cap > 0) && tv == &tv2_;
+  if (cap)
+    memset(slot_counts, 0, sizeof(slot_counts));
 
   Timer *old_list = Timer::GetObjectByID(tv->vec[index]);
   old_list->ListReplaceInit(tv_list);
@@ -226,29 +315,145 @@ int TimerSystem::Cascade(struct tvec *tv, int index) {
   // We are removing _all_ timers from the list, so we
   // don't have to detach them individually.
   Timer *timer = tv_list->GetNextObject();
+  stats_.cascades++;
+  int32_t slot_size = 0;
   while (timer != tv_list) {
     Timer *next = timer->GetNextObject();
-    DoInternalAddTimer(timer);
+    slot_size++;
+    if (unlikely(timer->Dead())) {
+      // lazy cancel的timer在这里回收, 整条链已经摘下来了, 不需要单独detach
+      active_timers_--;
+      all_timers_--;
+      dead_timers_--;
+      stats_.dead_reclaimed++;
+      FreeTimer(timer);
+    } else {
+      // 被TouchTimer推迟过的timer直接按新的超时挂到更低层, 省掉到期时的一次重挂
+      if (timer->DeferredExpires() > timer->Expires()) {
+        timer->SetExpires(timer->DeferredExpires());
+        timer->SetDeferredExpires(0);
+      }
+      if (cap) {
+        if (timer->Spread())
+          CapSpreadTimer(timer, slot_counts);
+        if (timer->Expires() - timer_jiffies_ < TVR_SIZE)
+          slot_counts[timer->Expires() & TVR_MASK]++;
+      }
+      DoInternalAddTimer(timer);
+      stats_.cascaded_timers++;
+    }
     timer = next;
   }
 
   tv_list->Destroy();
+  TIMER_PROBE4(cascade, tv == &tv2_ ? 2 : tv == &tv3_ ? 3 : tv == &tv4_ ? 4 : 5, index, slot_size,
+               timer_jiffies_);
 
   return index;
 }
 
+// 把RunTimers里摘下来的timer重新挂回去
+void TimerSystem::ReaddTimer(Timer *timer) {
+  DoInternalAddTimer(timer);
+  if (!active_timers_++ || timer->Expires() < next_timer_)
+    next_timer_ = timer->Expires();
+  all_timers_++;
+}
+
+// 把已经进入时间轮范围的溢出timer挂到tv5上, 计数在加入溢出堆时已经算过
+void TimerSystem::MigrateOverflowTimers() {
+  while (!overflow_.Empty() && overflow_.TopExpires() - timer_jiffies_ <= MAX_TVAL) {
+    DoInternalAddTimer(overflow_.Pop());
+  }
+}
+
+// 参考Linux的__next_timer_interrupt: tv1按槽找到最早的非空槽就是精确值;
+// tv2~tv5里的timer只能知道所在槽什么时候被cascade, 取最早的cascade时间点,
+// 醒来cascade之后再算一次就精确了, 最多多醒来轮盘层数次.
+int64_t TimerSystem::NextExpiry() {
+  if (!all_timers_)
+    return -1;
+  if (unlikely(priority_dispatch_)) {
+    for (int i = 0; i < TIMER_PRIORITY_CLASSES; i++) {
+      if (!Timer::GetObjectByID(deferred_lists_[i])->ListEmpty())
+        return timer_jiffies_;
+    }
+  }
+
+  int64_t next = INT64_MAX;
+  int index = timer_jiffies_ & TVR_MASK;
+  for (int i = 0; i < TVR_SIZE; i++) {
+    if (!Timer::GetObjectByID(tv1_.vec[(index + i) & TVR_MASK])->ListEmpty()) {
+      next = timer_jiffies_ + i;
+      break;
+    }
+  }
+
+  struct tvec *tvs[] = {&tv2_, &tv3_, &tv4_, &tv5_};
+  for (int n = 0; n < 4; n++) {
+    int shift = TVR_BITS + n * TVN_BITS;
+    int64_t base = timer_jiffies_ >> shift;
+    // 正好在边界上时当前槽马上就会被cascade
+    int d = (timer_jiffies_ & ((1LL << shift) - 1)) ? 1 : 0;
+    for (int end = d + TVN_SIZE; d < end; d++) {
+      int64_t cascade = (base + d) << shift;
+      if (cascade >= next)
+        break;
+      if (!Timer::GetObjectByID(tvs[n]->vec[(base + d) & TVN_MASK])->ListEmpty()) {
+        next = cascade;
+        break;
+      }
+    }
+  }
+
+  if (!overflow_.Empty()) {
+    int64_t migrate = overflow_.TopExpires() - MAX_TVAL;
+    if (migrate < timer_jiffies_)
+      migrate = timer_jiffies_;
+    if (migrate < next)
+      next = migrate;
+  }
+  return next == INT64_MAX ? -1 : next;
+}
+
 #define INDEX(N) ((timer_jiffies_ >> (TVR_BITS + (N)*TVN_BITS)) & TVN_MASK)
 
 // __run_timers - run all expired timers (if any)
 // This function Cascades all vectors and executes all expired timer
 // vectors.
 void TimerSystem::RunTimers(int64_t jiffies) {
+  TIMER_PROBE3(run_enter, jiffies, timer_jiffies_, all_timers_);
+  // 先执行外部积压的命令, trace里它们记在这次tick之前
+  if (unlikely(run_listener_ != nullptr)) {
+    run_listener_->OnRunTimers(jiffies);
+  }
+  if (unlikely(trace_)) {
+    Trace(TIMER_TRACE_TICK, jiffies, INVALID_ID);
+  }
+  if (unlikely(GetTimeDelta() != time_delta_)) {
+    RebaseLogicTimers();
+  }
+  if (unlikely(stale_timers_ > 0)) {
+    ReclaimStaleTimers(TIMER_STALE_RECLAIM_BATCH);
+  }
   if (CatchupTimerJiffies(jiffies)) {
+    TIMER_PROBE3(run_exit, jiffies, stats_.expired_timers, all_timers_);
     return;
   }
-  Timer *work_list = Timer::CreateInitListHead();
+  // 未开启统计时只有这一次判断
+  ExpiryProfiler *profiler = GetExpiryProfiler().Enabled() ? &GetExpiryProfiler() : nullptr;
+  running_ = true;
+  if (unlikely(priority_dispatch_)) {
+    budget_left_ = expiry_budget_ ? expiry_budget_ : INT64_MAX;
+    RunDeferredTimers(jiffies, profiler);
+  }
+  Timer *work_list = Timer::GetObjectByID(work_list_);
   while (jiffies >= timer_jiffies_) {
+    if (unlikely(jiffies - timer_jiffies_ > TVR_SIZE))
+      SkipIdleJiffies(jiffies);
     int index = ((uint64_t)timer_jiffies_) & TVR_MASK;
+    if (unlikely(!overflow_.Empty()))
+      MigrateOverflowTimers();
     // Cascade timers:
     if (!index && (!Cascade(&tv2_, INDEX(0))) && (!Cascade(&tv3_, INDEX(1))) &&
         !Cascade(&tv4_, INDEX(2)))
@@ -257,35 +462,174 @@ void TimerSystem::RunTimers(int64_t jiffies) {
     ++timer_jiffies_;
     Timer *timer_list = Timer::GetObjectByID(tv1_.vec[index]);
     timer_list->ListReplaceInit(work_list);
-    while (!work_list->ListEmpty()) {
-      Timer *timer = work_list->GetNextObject();
-      ExpiryAction *action = timer->Action();
-      int64_t data = timer->UserData();
-      DetachExpiredTimer(timer, jiffies);
-      if (action) {
-        action->OnExpiry(timer->GetGlobalID(), data);
+    if (likely(!priority_dispatch_)) {
+      while (!work_list->ListEmpty()) {
+        ExpireTimer(work_list->GetNextObject(), jiffies, profiler);
       }
-      if (0 == timer->Interval()) {
-        CIDRuntimeClass::DestroyObj(timer);
-      } else {
-        timer->SetExpires(timer->Expires() + timer->Interval());
-        DoInternalAddTimer(timer);
-        if (!active_timers_++ || timer->Expires() < next_timer_)
-          next_timer_ = timer->Expires();
-        all_timers_++;
+    } else {
+      DispatchByPriority(work_list, jiffies, profiler);
+    }
+  }
+  running_ = false;
+  // 回调里修改了时间偏移
+  if (unlikely(GetTimeDelta() != time_delta_)) {
+    RebaseLogicTimers();
+  }
+  TIMER_PROBE3(run_exit, jiffies, stats_.expired_timers, all_timers_);
+}
+
+// 要追的jiffies很多时(事件循环睡到NextExpiry才醒, 或者模拟时直接跳到下一个到期点),
+// 中间没有timer到期也没有非空槽要cascade的jiffy直接跳过, 不再逐个空转.
+// 当前tv1槽非空时NextExpiry就是timer_jiffies_, 不会多扫
+void TimerSystem::SkipIdleJiffies(int64_t jiffies) {
+  if (!Timer::GetObjectByID(tv1_.vec[timer_jiffies_ & TVR_MASK])->ListEmpty())
+    return;
+  int64_t next = NextExpiry();
+  if (next < 0 || next > jiffies)
+    next = jiffies;
+  if (next > timer_jiffies_)
+    timer_jiffies_ = next;
+}
+
+// 摘下一个到期的timer并处理: 回收dead, TouchTimer推迟过的重新挂载, 否则触发并按interval/cron续期
+void TimerSystem::ExpireTimer(Timer *timer, int64_t jiffies, ExpiryProfiler *profiler) {
+  DetachExpiredTimer(timer, jiffies);
+  if (unlikely(timer->Dead())) {
+    dead_timers_--;
+    stats_.dead_reclaimed++;
+    FreeTimer(timer);
+    return;
+  }
+  if (unlikely(timer->DeferredExpires() > timer->Expires())) {
+    // TouchTimer推迟过, 按新的超时重新挂载而不触发
+    timer->SetExpires(timer->DeferredExpires());
+    timer->SetDeferredExpires(0);
+    ReaddTimer(timer);
+    stats_.touch_requeued++;
+    return;
+  }
+  stats_.expired_timers++;
+  TimerPriorityStats &priority_stats = stats_.priority[timer->Priority()];
+  int64_t lateness = jiffies - timer->Expires();
+  priority_stats.expired++;
+  priority_stats.lateness_sum += lateness;
+  if (lateness > priority_stats.lateness_max)
+    priority_stats.lateness_max = lateness;
+  budget_left_--;
+  TIMER_PROBE5(expire, timer->TimerID(), timer->Action(), timer->UserData(), jiffies, lateness);
+  timer->SetFlag(TIMER_FLAG_RUNNING);
+  int64_t next = timer->Fire(jiffies, profiler);
+  timer->ClearFlag(TIMER_FLAG_RUNNING);
+  if (unlikely(timer->Epoch() != epoch_)) {
+    // 回调里ClearAll了: 重新挂载过的已经在待回收链表上, 否则直接回收
+    if (!timer->TimerPending())
+      ReclaimStaleTimer(timer);
+    return;
+  }
+  if (unlikely(timer->Dead())) {
+    // 回调里ClearTimer了自己
+    FreeTimer(timer);
+    return;
+  }
+  if (unlikely(timer->TimerPending() || timer->InHeap())) {
+    // 回调里ResetTimer/TouchTimer重新挂载了自己, 忽略返回值
+    return;
+  }
+  if (unlikely(next != TIMER_RESCHEDULE_REPEAT)) {
+    if (next < 0) {
+      FreeTimer(timer);
+      return;
+    }
+    // 从现在算起; 不能早于timer_jiffies_, 否则会落到刚处理过的tv1槽里等一整圈
+    int64_t expires = jiffies + next;
+    timer->SetExpires(expires < timer_jiffies_ ? timer_jiffies_ : expires);
+    ReaddTimer(timer);
+    return;
+  }
+  if (unlikely(timer->Cron())) {
+    RearmCronTimer(timer, jiffies);
+  } else if (0 == timer->Interval()) {
+    FreeTimer(timer);
+  } else {
+    timer->SetExpires(timer->Expires() + timer->Interval());
+    ReaddTimer(timer);
+  }
+}
+
+// 一个jiffy的timer先按优先级分开, 同一优先级内保持FIFO, 再从HIGH开始触发.
+// 预算用完后NORMAL/LOW的timer挂到推迟链表上, 仍计入计数, 期间可以正常Clear/Reset/Touch.
+void TimerSystem::DispatchByPriority(Timer *work_list, int64_t jiffies,
+                                     ExpiryProfiler *profiler) {
+  while (!work_list->ListEmpty()) {
+    Timer *timer = work_list->GetNextObject();
+    timer->DetachTimer(false);
+    timer->ListAddTail(Timer::GetObjectByID(priority_lists_[timer->Priority()]));
+  }
+  for (int i = 0; i < TIMER_PRIORITY_CLASSES; i++) {
+    Timer *list = Timer::GetObjectByID(priority_lists_[i]);
+    while (!list->ListEmpty()) {
+      Timer *timer = list->GetNextObject();
+      if (i != TIMER_PRIORITY_HIGH && budget_left_ <= 0 && !timer->Dead()) {
+        timer->DetachTimer(false);
+        timer->ListAddTail(Timer::GetObjectByID(deferred_lists_[i]));
+        stats_.priority[i].deferred++;
+        continue;
       }
+      ExpireTimer(timer, jiffies, profiler);
     }
   }
+}
 
-  work_list->Destroy();
+// 上次推迟的timer比本次新到期的更早, 先按优先级处理, 预算不够的继续留着
+void TimerSystem::RunDeferredTimers(int64_t jiffies, ExpiryProfiler *profiler) {
+  for (int i = 0; i < TIMER_PRIORITY_CLASSES; i++) {
+    Timer *list = Timer::GetObjectByID(deferred_lists_[i]);
+    while (!list->ListEmpty()) {
+      Timer *timer = list->GetNextObject();
+      if (budget_left_ <= 0 && !timer->Dead())
+        return;
+      ExpireTimer(timer, jiffies, profiler);
+    }
+  }
+}
+
+int TimerSystem::SetTimerPriority(int32_t timer_id, TimerPriority priority) {
+  if (priority < TIMER_PRIORITY_HIGH || priority >= TIMER_PRIORITY_CLASSES) {
+    return -1;
+  }
+  Timer *timer = LookupTimer(timer_id);
+  if (!timer) {
+    return -1;
+  }
+  timer->SetPriority(priority);
+  if (priority != TIMER_PRIORITY_NORMAL) {
+    priority_dispatch_ = true;
+  }
+  return 0;
+}
+
+void TimerSystem::SetExpiryBudget(int64_t budget) {
+  expiry_budget_ = budget > 0 ? budget : 0;
+  if (expiry_budget_) {
+    priority_dispatch_ = true;
+  }
 }
 
 int TimerSystem::SetTimer(ExpiryAction *action, int64_t expires, int64_t interval /* = 0*/,
                           int64_t user_data /* = 0*/) {
-  Timer *timer = dynamic_cast<Timer *>(CIDRuntimeClass::CreateObj(EOT_OBJ_TIMER));
+  Timer *timer = InternalSetTimer(action, expires, interval, user_data, true);
   if (!timer) {
     return INVALID_ID;
   }
+  return timer->TimerID();
+}
+
+Timer *TimerSystem::InternalSetTimer(ExpiryAction *action, int64_t expires, int64_t interval,
+                                     int64_t user_data, bool spread) {
+  Timer *timer = AllocTimer();
+  if (!timer) {
+    return nullptr;
+  }
 
   if (expires < 0) {
     expires = 0;
@@ -294,34 +638,97 @@ int TimerSystem::SetTimer(ExpiryAction *action, int64_t expires, int64_t interva
     interval = 0;
   }
 
-  timer->Init(action, GetRealTickTimeMs() + expires, interval, user_data);
-  AddTimer(timer, GetRealTickTimeMs());
-  GetRealTickTimeMs();
+  spread = spread && SpreadExpires(&expires, user_data ? user_data : timer->GetObjectID());
+  timer->Init(action, NowMs() + expires, interval, user_data);
+  timer->SetOwnerID(GetGlobalID());
+  timer->SetEpoch(epoch_);
+  if (unlikely(spread))
+    timer->SetFlag(TIMER_FLAG_SPREAD);
+  AddTimer(timer, NowMs());
+  TIMER_PROBE4(set, timer->TimerID(), action, user_data, timer->Expires());
 
-  return timer->GetGlobalID();
+  if (unlikely(trace_)) {
+    Trace(TIMER_TRACE_SET, NowMs(), timer->TimerID(), expires, interval, user_data);
+  }
+  return timer;
 }
 
 int TimerSystem::ClearTimer(int timer_id) {
-  Timer *timer =
-      dynamic_cast<Timer *>(CIDRuntimeClass::GetObjFromGlobalID(timer_id, EOT_OBJ_TIMER));
+  if (unlikely(trace_)) {
+    Trace(TIMER_TRACE_CLEAR, NowMs(), timer_id);
+  }
+  Timer *timer = LookupTimer(timer_id);
   if (!timer) {
     return -1;
   }
 
-  DelTimer(timer, GetRealTickTimeMs());
-  CIDRuntimeClass::DestroyObj(timer);
-
+  InternalClearTimer(timer);
   return 0;
 }
 
+int TimerSystem::ClearTimerGroup(int32_t group_id) {
+  TimerGroup *group = LookupTimerGroup(group_id);
+  if (!group) {
+    return -1;
+  }
+
+  int cleared = 0;
+  while (Timer *timer = group->First()) {
+    group->Remove(timer);
+    if (unlikely(timer->Epoch() != epoch_)) {
+      // ClearAll作废的timer只退出组, 由待回收链表回收
+      continue;
+    }
+    if (unlikely(trace_)) {
+      Trace(TIMER_TRACE_CLEAR, NowMs(), timer->TimerID());
+    }
+    InternalClearTimer(timer);
+    cleared++;
+  }
+  return cleared;
+}
+
+void TimerSystem::InternalClearTimer(Timer *timer) {
+  TIMER_PROBE4(clear, timer->TimerID(), timer->Action(), timer->UserData(), timer_jiffies_);
+  OnSiteClear(timer);
+  if (unlikely(timer->Running())) {
+    // 回调里清除自己(比如协程在回调里结束): 先摘下来, 回调返回后由RunTimers回收
+    DelTimer(timer, NowMs());
+    TimerGroup::Leave(timer);
+    names_.Remove(timer);
+    timer->SetFlag(TIMER_FLAG_DEAD);
+    return;
+  }
+
+  if (lazy_cancel_ && timer->TimerPending()) {
+    // dead timer不再算组成员, 也不再占着名字, 立即退出
+    TimerGroup::Leave(timer);
+    names_.Remove(timer);
+    timer->SetFlag(TIMER_FLAG_DEAD);
+    dead_timers_++;
+    return;
+  }
+
+  DelTimer(timer, NowMs());
+  FreeTimer(timer);
+}
+
 int TimerSystem::ResetTimer(int timer_id, ExpiryAction *action, int64_t expires,
                             int64_t interval /* = 0*/, int64_t user_data /* = 0*/) {
-  Timer *timer =
-      dynamic_cast<Timer *>(CIDRuntimeClass::GetObjFromGlobalID(timer_id, EOT_OBJ_TIMER));
+  if (unlikely(trace_)) {
+    Trace(TIMER_TRACE_RESET, NowMs(), timer_id, expires, interval, user_data);
+  }
+  Timer *timer = LookupTimer(timer_id);
   if (!timer) {
     return -1;
   }
 
+  InternalResetTimer(timer, action, expires, interval, user_data, true);
+  return 0;
+}
+
+void TimerSystem::InternalResetTimer(Timer *timer, ExpiryAction *action, int64_t expires,
+                                     int64_t interval, int64_t user_data, bool spread) {
   if (expires < 0) {
     expires = 0;
   }
@@ -329,8 +736,441 @@ int TimerSystem::ResetTimer(int timer_id, ExpiryAction *action, int64_t expires,
     interval = 0;
   }
 
-  DelTimer(timer, GetRealTickTimeMs());
-  timer->Init(action, GetRealTickTimeMs() + expires, interval, user_data);
-  AddTimer(timer, GetRealTickTimeMs());
+  if (timer->LogicTime()) {
+    UnlinkLogicTimer(timer);
+  }
+  DelTimer(timer, NowMs());
+  if (unlikely(timer->Named()) && action != timer->Action()) {
+    // 具名timer的身份是(action, key), 换了action就不再是原来那个名字, 退出索引
+    names_.Remove(timer);
+  }
+  spread = spread && SpreadExpires(&expires, user_data ? user_data : timer->GetObjectID());
+  timer->Init(action, NowMs() + expires, interval, user_data);
+  if (unlikely(spread))
+    timer->SetFlag(TIMER_FLAG_SPREAD);
+  AddTimer(timer, NowMs());
+  TIMER_PROBE4(reset, timer->TimerID(), action, user_data, timer->Expires());
+}
+
+int TimerSystem::TouchTimer(int timer_id, int64_t expires) {
+  if (unlikely(trace_)) {
+    Trace(TIMER_TRACE_TOUCH, NowMs(), timer_id, expires);
+  }
+  Timer *timer = LookupTimer(timer_id);
+  if (!timer) {
+    return -1;
+  }
+
+  if (expires < 0) {
+    expires = 0;
+  }
+  expires += NowMs();
+
+  // 在时间轮里且是往后推: 只记录, 不碰链表
+  if (timer->TimerPending() && expires >= timer->Expires()) {
+    timer->SetDeferredExpires(expires);
+    return 0;
+  }
+
+  InternalModTimer(timer, NowMs(), expires, false);
+  return 0;
+}
+
+int TimerSystem::SetNamedTimer(ExpiryAction *action, int64_t key, int64_t expires,
+                               int64_t interval /* = 0*/, int64_t user_data /* = 0*/) {
+  Timer *timer = names_.Find(action, key);
+  if (timer) {
+    if (unlikely(trace_)) {
+      Trace(TIMER_TRACE_RESET, NowMs(), timer->TimerID(), expires, interval,
+            user_data);
+    }
+    InternalResetTimer(timer, action, expires, interval, user_data);
+    return timer->TimerID();
+  }
+
+  if (names_.Full()) {
+    LogWarnM(LOGM_SYS, "timer name index full, size:%d", names_.Size());
+    return INVALID_ID;
+  }
+  timer = InternalSetTimer(action, expires, interval, user_data);
+  if (!timer) {
+    return INVALID_ID;
+  }
+  names_.Insert(timer, key);
+  return timer->TimerID();
+}
+
+int TimerSystem::ClearNamedTimer(ExpiryAction *action, int64_t key) {
+  Timer *timer = names_.Find(action, key);
+  if (!timer) {
+    return -1;
+  }
+
+  if (unlikely(trace_)) {
+    Trace(TIMER_TRACE_CLEAR, NowMs(), timer->TimerID());
+  }
+  InternalClearTimer(timer);
   return 0;
 }
+
+int TimerSystem::FindNamedTimer(ExpiryAction *action, int64_t key) {
+  Timer *timer = names_.Find(action, key);
+  return timer ? timer->TimerID() : INVALID_ID;
+}
+
+int TimerSystem::SetCronTimer(ExpiryAction *action, const char *spec, int64_t user_data) {
+  CronSchedule schedule;
+  if (!spec || schedule.Compile(spec) != 0) {
+    LogWarnM(LOGM_SYS, "invalid cron spec:%s", spec ? spec : "");
+    return INVALID_ID;
+  }
+  return SetCronTimer(action, schedule, user_data);
+}
+
+int TimerSystem::SetCronTimer(ExpiryAction *action, const CronSchedule &schedule,
+                              int64_t user_data) {
+  if (!action) {
+    return INVALID_ID;
+  }
+  // 和SetTimerAt一样按逻辑时间计算, 先对齐time_delta_
+  RebaseLogicTimers();
+  int64_t delta_ms = time_delta_ * SECOND_MS;
+  time_t next = schedule.Next((NowMs() + delta_ms) / SECOND_MS);
+  if (next < 0) {
+    LogWarnM(LOGM_SYS, "cron spec never fires, user_data:%ld", user_data);
+    return INVALID_ID;
+  }
+  int64_t expires = next * SECOND_MS - delta_ms - NowMs();
+  // cron单独记一条TIMER_TRACE_CRON, 不记成一次性的SET
+  bool trace = trace_;
+  trace_ = false;
+  Timer *timer = InternalSetTimer(action, expires, 0, user_data);
+  trace_ = trace;
+  if (!timer) {
+    return INVALID_ID;
+  }
+  timer->SetCron(schedule);
+  LinkLogicTimer(timer);
+  if (unlikely(trace_)) {
+    TimerTraceRecord record = {};
+    record.op = TIMER_TRACE_CRON;
+    record.system_id = SystemID();
+    record.jiffies = NowMs();
+    record.timer_id = timer->TimerID();
+    record.expires = expires;
+    record.user_data = user_data;
+    record.cron = schedule;
+    GetTimerTraceWriter().Write(record);
+  }
+  return timer->TimerID();
+}
+
+// 从本次应触发的时间点往后找下一次, 落后超过一个周期时从当前时间往后找, 错过的不补.
+// 按逻辑时间计算, 和其他逻辑时间timer用同一个time_delta_, 回调里改了偏移时RunTimers结束后一起平移
+void TimerSystem::RearmCronTimer(Timer *timer, int64_t jiffies) {
+  int64_t base = timer->Expires() > jiffies ? timer->Expires() : jiffies;
+  int64_t delta_ms = time_delta_ * SECOND_MS;
+  time_t next = timer->GetCron().Next((base + delta_ms) / SECOND_MS);
+  if (next < 0) {
+    FreeTimer(timer);
+    return;
+  }
+  timer->SetExpires(next * SECOND_MS - delta_ms);
+  ReaddTimer(timer);
+}
+
+int TimerSystem::SetTimerAt(ExpiryAction *action, int64_t logic_ms, int64_t interval,
+                            int64_t user_data) {
+  // 先按当前偏移把已有的逻辑时间timer对齐, 保证所有逻辑时间timer用的是同一个time_delta_
+  RebaseLogicTimers();
+  int64_t expires = logic_ms - time_delta_ * SECOND_MS - NowMs();
+  // 记成SET_AT, 回放时仍是逻辑时间timer
+  bool trace = trace_;
+  trace_ = false;
+  Timer *timer = InternalSetTimer(action, expires, interval, user_data);
+  trace_ = trace;
+  if (!timer) {
+    return INVALID_ID;
+  }
+  LinkLogicTimer(timer);
+  if (unlikely(trace_)) {
+    Trace(TIMER_TRACE_SET_AT, NowMs(), timer->TimerID(), expires, interval, user_data);
+  }
+  return timer->TimerID();
+}
+
+// 逻辑时间timer挂到链表头, 和TimerGroup一样是不循环的双向链表
+void TimerSystem::LinkLogicTimer(Timer *timer) {
+  int32_t self = timer->GetObjectID();
+  int32_t *links = timer->LogicLinks();
+  links[0] = INVALID_ID;
+  links[1] = logic_list_;
+  if (logic_list_ >= 0)
+    Timer::GetObjectByID(logic_list_)->LogicLinks()[0] = self;
+  logic_list_ = self;
+  timer->SetFlag(TIMER_FLAG_LOGIC);
+  logic_timers_++;
+}
+
+void TimerSystem::UnlinkLogicTimer(Timer *timer) {
+  int32_t *links = timer->LogicLinks();
+  if (links[0] >= 0) {
+    Timer::GetObjectByID(links[0])->LogicLinks()[1] = links[1];
+  } else {
+    logic_list_ = links[1];
+  }
+  if (links[1] >= 0)
+    Timer::GetObjectByID(links[1])->LogicLinks()[0] = links[0];
+  timer->ClearFlag(TIMER_FLAG_LOGIC);
+  logic_timers_--;
+}
+
+int TimerSystem::RebaseLogicTimers() {
+  int64_t delta = GetTimeDelta();
+  if (delta == time_delta_ || running_) {
+    return 0;
+  }
+  // 逻辑时间往后调, 同一个逻辑时间点在真实时间上就提前
+  int64_t shift = (time_delta_ - delta) * SECOND_MS;
+  time_delta_ = delta;
+
+  // 不在RunTimers里, work_list_和priority_lists_都是空的, 逻辑时间timer只会在轮盘,
+  // 溢出堆或者预算推迟链表上. 推迟链表上的本来就已经到期, 摘下来挂回当前槽不改变计数
+  int rebased = 0;
+  int64_t earliest = INT64_MAX;
+  for (int32_t id = logic_list_; id >= 0;) {
+    Timer *timer = Timer::GetObjectByID(id);
+    id = timer->LogicLinks()[1];
+    if (timer->InHeap()) {
+      overflow_.Remove(timer);
+    } else if (timer->TimerPending()) {
+      timer->DetachTimer(true);
+    } else {
+      continue;
+    }
+    int64_t expires = timer->Expires() + shift;
+    // 已经错过的挂到当前槽, 下一次RunTimers触发
+    if (expires < timer_jiffies_)
+      expires = timer_jiffies_;
+    timer->SetExpires(expires);
+    if (timer->DeferredExpires() > 0)
+      timer->SetDeferredExpires(timer->DeferredExpires() + shift);
+    DoInternalAddTimer(timer);
+    if (expires < earliest)
+      earliest = expires;
+    rebased++;
+  }
+
+  if (earliest < next_timer_)
+    next_timer_ = earliest;
+  if (rebased && unlikely(arm_listener_ != nullptr))
+    arm_listener_->OnTimerArmed(earliest);
+  return rebased;
+}
+
+void TimerSystem::FreeTimer(Timer *timer) {
+  if (timer->LogicTime()) {
+    UnlinkLogicTimer(timer);
+  }
+  names_.Remove(timer);
+  ReleaseTimer(timer);
+}
+
+void TimerSystem::ClearAll() {
+  if (unlikely(trace_)) {
+    Trace(TIMER_TRACE_CLEAR_ALL, NowMs(), INVALID_ID);
+  }
+  // epoch是16位的, 回绕后还没回收的timer的epoch会重新和epoch_相等, 回绕前先全部回收
+  if (unlikely(epoch_ == UINT16_MAX) && stale_timers_ > 0) {
+    ReclaimStaleTimers(stale_timers_);
+  }
+  epoch_++;
+  Timer *stale = Timer::GetObjectByID(stale_list_);
+  for (int i = 0; i < TVR_SIZE; i++) {
+    Timer::GetObjectByID(tv1_.vec[i])->ListSpliceTailInit(stale);
+  }
+  for (int i = 0; i < TVN_SIZE; i++) {
+    Timer::GetObjectByID(tv2_.vec[i])->ListSpliceTailInit(stale);
+    Timer::GetObjectByID(tv3_.vec[i])->ListSpliceTailInit(stale);
+    Timer::GetObjectByID(tv4_.vec[i])->ListSpliceTailInit(stale);
+    Timer::GetObjectByID(tv5_.vec[i])->ListSpliceTailInit(stale);
+  }
+  for (int i = 0; i < TIMER_PRIORITY_CLASSES; i++) {
+    Timer::GetObjectByID(priority_lists_[i])->ListSpliceTailInit(stale);
+    Timer::GetObjectByID(deferred_lists_[i])->ListSpliceTailInit(stale);
+  }
+  // 在回调里调用时, 本jiffy还没触发的timer也不再触发
+  Timer::GetObjectByID(work_list_)->ListSpliceTailInit(stale);
+  // 溢出堆最多TIMER_OVERFLOW_CAPACITY个, 逐个挪到链表上
+  for (int32_t i = 0; i < overflow_.Size(); i++) {
+    Timer *timer = overflow_.At(i);
+    timer->heap_index_ = -1;
+    timer->ListAddTail(stale);
+  }
+  overflow_.Clear();
+  names_.Clear();
+
+  stale_timers_ += all_timers_;
+  all_timers_ = 0;
+  active_timers_ = 0;
+  dead_timers_ = 0;
+  logic_timers_ = 0;
+  logic_list_ = INVALID_ID;
+  next_timer_ = timer_jiffies_;
+}
+
+int64_t TimerSystem::ReclaimStaleTimers(int64_t max_count) {
+  Timer *stale = Timer::GetObjectByID(stale_list_);
+  int64_t reclaimed = 0;
+  while (reclaimed < max_count && !stale->ListEmpty()) {
+    Timer *timer = stale->GetNextObject();
+    timer->DetachTimer(true);
+    // 回调里重新挂载了自己又被ClearAll的timer, 回调返回后由ExpireTimer回收
+    if (likely(!timer->Running()))
+      ReclaimStaleTimer(timer);
+    reclaimed++;
+  }
+  stale_timers_ -= reclaimed;
+  return reclaimed;
+}
+
+// 作废的timer不在索引和各项计数里, 不能走FreeTimer
+void TimerSystem::ReclaimStaleTimer(Timer *timer) {
+  timer->ClearFlag(TIMER_FLAG_NAMED);
+  ReleaseTimer(timer);
+}
+
+Timer *TimerSystem::AllocTimer() {
+  Timer *free_list = Timer::GetObjectByID(free_list_);
+  if (!free_list->ListEmpty()) {
+    Timer *timer = free_list->GetNextObject();
+    timer->DetachTimer(true);
+    uint8_t generation = timer->Generation();
+    timer->CreateInit();
+    timer->SetGeneration(generation);
+    slab_.free--;
+    slab_.reused++;
+    return timer;
+  }
+  // 类型由EOT_OBJ_TIMER保证, 不需要dynamic_cast
+  Timer *timer = static_cast<Timer *>(CIDRuntimeClass::CreateObj(EOT_OBJ_TIMER));
+  if (!timer)
+    return nullptr;
+  slab_.created++;
+  // 开过slab之后TIMER_ID_REUSED位表示generation, 这样的globalid返回出去会被解码错
+  if (unlikely(encode_ids_ && timer->GetGlobalID() >= TIMER_ID_REUSED)) {
+    LogWarnM(LOGM_SYS, "alloc timer failed, globalid:%d out of timer id range",
+             timer->GetGlobalID());
+    CIDRuntimeClass::DestroyObj(timer);
+    slab_.rejected++;
+    return nullptr;
+  }
+  return timer;
+}
+
+// 调用方保证timer已经不在任何链表和堆里, 也不在具名索引里
+void TimerSystem::ReleaseTimer(Timer *timer) {
+  OnSiteRelease(timer);
+  // globalid放不进timer id的不进slab
+  if (unlikely(timer->GetGlobalID() > TIMER_ID_GLOBALID_MASK) && slab_.capacity > 0) {
+    if (slab_.rejected == 0)
+      LogWarnM(LOGM_SYS, "timer globalid:%d out of slab range, released to pool",
+               timer->GetGlobalID());
+    CIDRuntimeClass::DestroyObj(timer);
+    slab_.rejected++;
+    return;
+  }
+  // generation用完的还给对象池, 旧id不会和复用后的id相同
+  if (slab_.free >= slab_.capacity || timer->Generation() >= TIMER_ID_GENERATION_MAX) {
+    CIDRuntimeClass::DestroyObj(timer);
+    slab_.released++;
+    return;
+  }
+  TimerGroup::Leave(timer);
+  // 空闲的timer对Clear/Reset/Touch/JoinTimerGroup都无效
+  timer->SetFlag(TIMER_FLAG_DEAD);
+  timer->SetGeneration(timer->Generation() + 1);
+  timer->ListAdd(Timer::GetObjectByID(free_list_));
+  slab_.free++;
+}
+
+void TimerSystem::SetTimerSlabCapacity(int64_t capacity) {
+  slab_.capacity = capacity > 0 ? capacity : 0;
+  if (slab_.capacity > 0)
+    encode_ids_ = true;
+  Timer *free_list = Timer::GetObjectByID(free_list_);
+  while (slab_.free > slab_.capacity) {
+    Timer *timer = free_list->GetNextObject();
+    timer->DetachTimer(true);
+    CIDRuntimeClass::DestroyObj(timer);
+    slab_.free--;
+    slab_.released++;
+  }
+}
+
+int TimerSystem::BindTimerArena(const TimerArenaOptions &options, TimerArenaResult *result) {
+  Timer *free_list = Timer::GetObjectByID(free_list_);
+  if (free_list->ListEmpty()) {
+    return -1;
+  }
+  // timer所在的页, 一个timer可能跨两页
+  uintptr_t page_size = static_cast<uintptr_t>(getpagesize());
+  std::vector<uintptr_t> pages;
+  pages.reserve(slab_.free);
+  for (Timer *timer = free_list->GetNextObject(); timer != free_list;
+       timer = timer->GetNextObject()) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(timer);
+    for (uintptr_t page = addr & ~(page_size - 1); page < addr + sizeof(Timer); page += page_size)
+      pages.push_back(page);
+  }
+  std::sort(pages.begin(), pages.end());
+  pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+  // 相邻的页合并成区间, 区间之间的页不属于timer, 不动它们
+  std::vector<TimerArenaRange> ranges;
+  for (uintptr_t page : pages) {
+    if (!ranges.empty() && ranges.back().end == page) {
+      ranges.back().end += page_size;
+    } else {
+      ranges.push_back({page, page + page_size});
+    }
+  }
+  return TimerArenaAdvise(ranges.data(), static_cast<int>(ranges.size()), options, result);
+}
+
+int64_t TimerSystem::ReserveTimers(int64_t count) {
+  if (slab_.capacity < count)
+    slab_.capacity = count;
+  if (slab_.capacity > 0)
+    encode_ids_ = true;
+  while (slab_.free < count) {
+    Timer *timer = static_cast<Timer *>(CIDRuntimeClass::CreateObj(EOT_OBJ_TIMER));
+    if (!timer) {
+      LogWarnM(LOGM_SYS, "reserve timers failed, free:%ld count:%ld", slab_.free, count);
+      break;
+    }
+    slab_.created++;
+    if (timer->GetGlobalID() > TIMER_ID_GLOBALID_MASK) {
+      // 对象池会把同一个globalid再分配出来, 继续创建不会有进展
+      LogWarnM(LOGM_SYS, "reserve timers stopped, globalid:%d out of range, free:%ld count:%ld",
+               timer->GetGlobalID(), slab_.free, count);
+      CIDRuntimeClass::DestroyObj(timer);
+      slab_.rejected++;
+      break;
+    }
+    ReleaseTimer(timer);
+  }
+  return count > slab_.free ? count - slab_.free : 0;
+}
+
+void TimerSystem::Trace(int op, int64_t jiffies, int32_t timer_id, int64_t expires,
+                        int64_t interval, int64_t user_data) {
+  TimerTraceRecord record = {};
+  record.op = op;
+  record.system_id = SystemID();
+  record.jiffies = jiffies;
+  record.timer_id = timer_id;
+  record.expires = expires;
+  record.interval = interval;
+  record.user_data = user_data;
+  GetTimerTraceWriter().Write(record);
+}
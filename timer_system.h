@@ -8,7 +8,10 @@
 #include "comm_base.h"
 #include "comm_service_interface.h"
 #include "timer.h"
+#include "timer_arena.h"
 #include "timer_defines.h"
+#include "timer_heap.h"
+#include "timer_name_index.h"
 #include "timer_system_interface.h"
 
 struct tvec {
@@ -19,35 +22,161 @@ struct tvec_root {
   int32_t vec[TVR_SIZE];  // store list head obj
 };
 
+// 每个优先级的到期统计, 延迟按RunTimers的jiffies和timer的超时时间点计算
+struct TimerPriorityStats {
+  int64_t expired;       // 触发的timer数
+  int64_t deferred;      // 超出预算被推迟的次数
+  int64_t lateness_sum;  // 累计延迟ms
+  int64_t lateness_max;  // 最大延迟ms
+};
+
+// 运行统计, 给benchmark和监控用
+struct TimerStats {
+  int64_t cascades;         // Cascade的次数
+  int64_t cascaded_timers;  // Cascade中重新挂载的timer数
+  int64_t expired_timers;   // 超时触发的timer数
+  int64_t dead_reclaimed;   // lazy cancel后被批量回收的timer数
+  int64_t touch_requeued;   // TouchTimer推迟后到达旧槽被重新挂载的timer数
+  int64_t spread_shifted;   // 打散timer因槽满被顺延的次数
+  TimerPriorityStats priority[TIMER_PRIORITY_CLASSES];
+};
+
+// timer slab的统计, 见TimerSystem::SetTimerSlabCapacity
+struct TimerSlabStats {
+  int64_t capacity;  // 最多缓存的空闲timer数, 0表示不缓存
+  int64_t free;      // 当前缓存的空闲timer数
+  int64_t reused;    // 从空闲链表分配的次数
+  int64_t created;   // 从对象池创建的次数
+  int64_t released;  // 超出容量或generation用完还给对象池的次数
+  int64_t rejected;  // globalid超出TIMER_ID_GLOBALID_MASK, 不能进slab直接销毁的次数
+};
+
 class TimerSystem : public CObj, public TimerSystemInterface, public IService {
  public:
   TimerSystem();
   virtual ~TimerSystem();
   virtual const char* ClassName() { return "TimerSystem"; }
   void CreateInit();
-  void ResumeInit() {}
+  // 上一个进程可能退出在回调里
+  void ResumeInit() { running_ = false; }
 
  public:
+  virtual int32_t SystemID() override { return GetGlobalID(); }
+
+  // 下面的override会隐藏基类的同名重载(TimeHelper/内联回调/TimerSite), 这里重新引入
+  using TimerSystemInterface::ResetTimer;
+  using TimerSystemInterface::SetTimer;
+  using TimerSystemInterface::TouchTimer;
+
   // @expires 超时时间，距离当前时间的Millis, 小于0的值会被修正为0
   // @interval 循环间隔Milliseconds, interval = 0表示非循环, 小于0的值会被修正为0
-  // @return 返回timer的globalid,
-  // 用dynamic_cast<Timer*>(CIDRuntimeClass::GetObjFromGlobalID(timer_globalid,
-  // EOT_OBJ_TIMER))获取对象
+  // @return 返回timer id, 用GetTimer获取对象
   virtual int SetTimer(ExpiryAction* action, int64_t expires, int64_t interval = 0,
                        int64_t user_data = 0) override;
 
-  // @timer_id timer的globalid
+  // @timer_id timer id
+  // lazy cancel模式下只打标记, timer在cascade或到期时回收, 之后对它的Clear/Reset都返回-1
   virtual int ClearTimer(int32_t timer_id) override;
 
-  // @timer_id timer的globalid
+  // @timer_id timer id
   // 其他参数同SetTimer, 重置timer的参数, 以调用时刻重新计算超时
   // @return 0=success, <0=failed.
   virtual int ResetTimer(int32_t timer_id, ExpiryAction* action, int64_t expires,
                          int64_t interval = 0, int64_t user_data = 0) override;
 
+  // @timer_id timer id
+  // @expires 新的超时时间, 距离当前时间的Millis, 见TimerSystemInterface::TouchTimer
+  virtual int TouchTimer(int32_t timer_id, int64_t expires) override;
+
+  // lazy cancel模式下组内timer同样只打标记
+  virtual int ClearTimerGroup(int32_t group_id) override;
+
+  // 见TimerSystemInterface::SetNamedTimer, 索引容量TIMER_NAME_INDEX_CAPACITY
+  virtual int SetNamedTimer(ExpiryAction* action, int64_t key, int64_t expires,
+                            int64_t interval = 0, int64_t user_data = 0) override;
+  virtual int ClearNamedTimer(ExpiryAction* action, int64_t key) override;
+  virtual int FindNamedTimer(ExpiryAction* action, int64_t key) override;
+
+  // 按crontab表达式周期触发, 如"0 3 * * 1"每周一3点, 格式见timer_cron.h
+  // 表达式只在这里解析一次, 之后每次到期按编译好的位图算出下一次并重新挂载, 精确到分钟.
+  // 和GetNextCrontabTime一样按逻辑时间(带time_delta_)计算, 属于逻辑时间timer,
+  // time_delta_变化后同SetTimerAt一起平移. ClearTimer停止; ResetTimer后变回普通timer.
+  // @return timer id, 表达式非法或永远不会触发返回INVALID_ID
+  int SetCronTimer(ExpiryAction* action, const char* spec, int64_t user_data = 0);
+  // 已经编译好的表达式, timer_replay按trace里记录的CronSchedule重建cron timer时用
+  int SetCronTimer(ExpiryAction* action, const CronSchedule& schedule, int64_t user_data = 0);
+
+  // 在逻辑时间(GetTickTimeMs(), 带CTimeSource的time_delta_)的某个时间点触发
+  // 时间轮按真实时间走, 这类timer在time_delta_变化后由RebaseLogicTimers整体平移到新的位置,
+  // 之前的时间点被跳过时在下一次RunTimers立即触发. ResetTimer后变回普通的相对timer.
+  // @logic_ms 逻辑时间的毫秒时间戳
+  // @interval 循环间隔Milliseconds, 同SetTimer
+  // @return timer id
+  int SetTimerAt(ExpiryAction* action, int64_t logic_ms, int64_t interval = 0,
+                 int64_t user_data = 0);
+
+  // time_delta_变化后把所有逻辑时间timer一次性重新挂载: 沿逻辑时间timer链表遍历, 代价只和
+  // 逻辑时间timer数有关, 不扫描轮盘. 不管它们在轮盘, 溢出堆还是预算推迟链表上, 都摘下来按新
+  // 偏移重新挂载, 不经过ResetTimer的查找和重建. RunTimers开头和结束时会自动检查,
+  // 修改时间偏移后想立即生效(比如马上NextExpiry)时可以手动调用.
+  // 在回调里调用(包括回调里的SetTimerAt/SetCronTimer)时不平移, 推迟到本次RunTimers结束,
+  // 期间新建的逻辑时间timer仍按旧偏移计算, 结束时和其他逻辑时间timer一起平移.
+  // @return 重新挂载的timer数
+  int RebaseLogicTimers();
+
+  // 设置timer的到期优先级, ResetTimer后保留. 同一jiffy里按HIGH, NORMAL, LOW的顺序触发,
+  // 同一优先级内仍然FIFO. 第一次设置非NORMAL优先级后RunTimers才开始按优先级分发.
+  // @return 0=success, <0=failed.
+  int SetTimerPriority(int32_t timer_id, TimerPriority priority);
+
+  // 每次RunTimers最多触发的timer数, 0表示不限. HIGH不受限制但占用预算,
+  // 预算用完后NORMAL和LOW的timer推迟到下一次RunTimers, 按优先级排在新到期的timer之前.
+  // 过载时LOW总是最先被推迟, 效果见Stats().priority.
+  void SetExpiryBudget(int64_t budget);
+
+  // 一次作废本实例的所有timer, 比如销毁整个副本: 递增epoch, 把各层轮盘/溢出堆/推迟链表上的
+  // timer整条链拼到待回收链表上, 代价和槽数有关, 和timer数无关. 作废的timer之后对
+  // Clear/Reset/Touch/JoinTimerGroup都返回-1, 不再触发, 由之后的RunTimers每次回收
+  // TIMER_STALE_RECLAIM_BATCH个.
+  // 具名索引清空; 作废的timer回收前仍算在所在TimerGroup里.
+  // 可以在回调里调用, 同一次RunTimers里还没触发的timer不再触发.
+  // epoch是16位的, 即将回绕时先同步回收所有还没回收的timer, 回绕后不会把旧timer当成有效的.
+  void ClearAll();
+
+  // 回收最多max_count个ClearAll作废的timer
+  // @return 回收的个数
+  int64_t ReclaimStaleTimers(int64_t max_count);
+
+  // timer slab: 释放的timer不还给对象池, 挂到本实例的空闲链表头上, SetTimer优先复用最近释放的,
+  // 省掉对象池的创建/销毁, 复用的对象大概率还在cache里. 空闲链表和timer一样存obj_id,
+  // 在共享内存里, resume后继续可用. 默认关闭.
+  // 复用的timer保留原来的globalid, 返回的timer id里带上generation(见TIMER_ID_REUSED),
+  // 到期或被清除后留下的旧id对Clear/Reset/Touch无效, 不会操作到复用它的新timer.
+  // 对globalid的限制(对象池的globalid范围要按这个配置):
+  //   1. 开过slab之后(capacity>0, 之后再关闭也一样)本系统才按TIMER_ID_REUSED解码timer id,
+  //      新建timer的globalid必须小于TIMER_ID_REUSED(2^30), 超出的SetTimer失败并打日志.
+  //      开启之前已经存在的timer不检查, 所以要在创建timer之前开启
+  //   2. 只有globalid不超过TIMER_ID_GLOBALID_MASK(2^24-1)的timer进slab, 超出的直接还给
+  //      对象池, 计入SlabStats().rejected, 第一次发生时打日志
+  // @capacity 最多缓存的空闲timer数, 0关闭, 多出来的还给对象池
+  void SetTimerSlabCapacity(int64_t capacity);
+  // 预先创建timer放进空闲链表, 容量小于count时扩大到count. globalid的限制同上,
+  // 对象池不够或者globalid超出TIMER_ID_GLOBALID_MASK时停止, 不重试
+  // @return 没能预留的个数, 0表示空闲链表里已经有count个
+  int64_t ReserveTimers(int64_t count);
+  const TimerSlabStats& SlabStats() { return slab_; }
+  // 对slab空闲链表里的timer所在的页应用大页/NUMA策略, 见timer_arena.h.
+  // 先ReserveTimers预留够timer, 之后SetTimer都从这些页里分配. 只处理包含timer的页,
+  // 夹在中间的其他对象的页不迁移也不合并; 和timer共用一页的对象会随这一页迁移到同一个节点,
+  // 只有整个2MB都是这样的页时才合并成大页.
+  // @return 0=success, <0=空闲链表为空
+  int BindTimerArena(const TimerArenaOptions& options, TimerArenaResult* result);
+
  public:
-  int Init(int64_t jiffies);
-  void RunTimers(int64_t jiffies);
+  virtual int Init(int64_t jiffies) override;
+  virtual void RunTimers(int64_t jiffies) override;
+  // 高层轮盘里的timer返回所在槽的cascade时间点, 溢出堆里的返回迁移时间点
+  virtual int64_t NextExpiry() override;
 
  public:
   void AddTimer(Timer* timer, int64_t jiffies);
@@ -58,22 +187,84 @@ class TimerSystem : public CObj, public TimerSystemInterface, public IService {
 
  public:
   int64_t AllTimers() { return all_timers_; }
+  int64_t OverflowTimers() { return overflow_.Size(); }
+  int64_t NamedTimers() { return names_.Size(); }
+  const TimerStats& Stats() { return stats_; }
+  void ResetStats() { memset(&stats_, 0, sizeof(stats_)); }
+
+  // 开启后本实例的Set/Clear/Reset/RunTimers会写入GetTimerTraceWriter(), 供timer_replay回放.
+  // 多个实例写同一个文件时记录按SystemID()区分
+  void EnableTrace(bool enable) { trace_ = enable; }
+
+  // lazy cancel: ClearTimer只给timer打上TIMER_FLAG_DEAD, 不摘链不销毁, 省掉邻居节点的写,
+  // 等所在的槽被cascade或到期时批量回收. 适合绝大部分timer在超时前就被取消的场景.
+  // 开启后AllTimers()包含尚未回收的dead timer.
+  void SetLazyCancel(bool enable) { lazy_cancel_ = enable; }
+  bool LazyCancel() { return lazy_cancel_; }
+  int64_t DeadTimers() { return dead_timers_; }
+  int64_t LogicTimers() { return logic_timers_; }
+  // ClearAll作废了还没回收的timer数, 不计入AllTimers
+  int64_t StaleTimers() { return stale_timers_; }
+  int64_t DeadTimerBytes() { return dead_timers_ * static_cast<int64_t>(sizeof(Timer)); }
 
  private:
   void InternalAddTimer(Timer* timer, int64_t jiffies);
   void DoInternalAddTimer(Timer* timer);
   int DetachIfPending(Timer* timer, bool clear_pending, int64_t jiffies);
   int InternalModTimer(Timer* timer, int64_t jiffies, int64_t expires, bool pending_only);
+  virtual Timer* InternalSetTimer(ExpiryAction* action, int64_t expires, int64_t interval,
+                                  int64_t user_data, bool spread = false) override;
+  virtual bool TimerIDsEncoded() override { return encode_ids_; }
+  virtual uint16_t CurrentEpoch() override { return epoch_; }
+  void InternalResetTimer(Timer* timer, ExpiryAction* action, int64_t expires, int64_t interval,
+                          int64_t user_data, bool spread = false);
+  void InternalClearTimer(Timer* timer);
 
   void DetachExpiredTimer(Timer* timer, int64_t jiffies);
   bool CatchupTimerJiffies(int64_t jiffies);
+  void MigrateOverflowTimers();
+  void ReaddTimer(Timer* timer);
+  void RearmCronTimer(Timer* timer, int64_t jiffies);
+  void LinkLogicTimer(Timer* timer);
+  void UnlinkLogicTimer(Timer* timer);
+  void FreeTimer(Timer* timer);
+  void ReclaimStaleTimer(Timer* timer);
+  Timer* AllocTimer();
+  void ReleaseTimer(Timer* timer);
   int Cascade(struct tvec* tv, int index);
+  void CapSpreadTimer(Timer* timer, int32_t* slot_counts);
+  void SkipIdleJiffies(int64_t jiffies);
+  void ExpireTimer(Timer* timer, int64_t jiffies, ExpiryProfiler* profiler);
+  void DispatchByPriority(Timer* work_list, int64_t jiffies, ExpiryProfiler* profiler);
+  void RunDeferredTimers(int64_t jiffies, ExpiryProfiler* profiler);
+  void Trace(int op, int64_t jiffies, int32_t timer_id, int64_t expires = 0, int64_t interval = 0,
+             int64_t user_data = 0);
 
  private:
   int64_t timer_jiffies_;  // 当前jiffies
   int64_t next_timer_;     // 最近超时timer的jiffies
   int64_t active_timers_;  // 活跃timer计数
   int64_t all_timers_;     // timers 总计数
+  TimerStats stats_;       // 运行统计
+  bool trace_;             // 是否录制trace
+  bool lazy_cancel_;       // 是否lazy cancel
+  int64_t dead_timers_;    // 已lazy cancel还未回收的timer数
+  int64_t time_delta_;     // 逻辑时间timer按这个时间偏移(秒)挂载
+  int64_t logic_timers_;   // SetTimerAt和cron的timer数
+  int32_t logic_list_;     // 逻辑时间timer链表头的obj_id, 节点见Timer::LogicLinks
+  bool running_;           // RunTimers正在触发回调, 逻辑时间timer推迟到结束后再平移
+  bool priority_dispatch_;  // 用过优先级或预算之后按优先级分发
+  int64_t expiry_budget_;   // 每次RunTimers最多触发的timer数, 0表示不限
+  int64_t budget_left_;     // 本次RunTimers剩余的预算
+  int32_t priority_lists_[TIMER_PRIORITY_CLASSES];  // 分发时按优先级暂存一个jiffy的timer
+  int32_t deferred_lists_[TIMER_PRIORITY_CLASSES];  // 超出预算推迟的timer, 仍计入AllTimers
+  uint16_t epoch_;          // ClearAll递增, 新建的timer记录这个值
+  int64_t stale_timers_;    // 待回收链表上的timer数
+  int32_t stale_list_;      // ClearAll作废的timer, RunTimers分批回收
+  int32_t work_list_;       // RunTimers正在处理的一个jiffy的timer, ClearAll时一并作废
+  TimerSlabStats slab_;     // capacity为0时不缓存
+  int32_t free_list_;       // 空闲timer, 从链表头进出(LIFO), 都带TIMER_FLAG_DEAD
+  bool encode_ids_;         // 开过slab, timer id可能带generation, 之后一直解码
   // 这里tv1~tv5分别是时间轮的5级轮盘Linux定时器时间轮分为5个级别的轮子(tv1 ~ tv5)。
   // 每个级别的轮子的刻度值(slot)不同，规律是次级轮子的slot等于上级轮子的slot之和。
   // Linux定时器slot单位为1jiffy，tv1轮子分256个刻度，每个刻度大小为1jiffy。
@@ -87,6 +278,11 @@ class TimerSystem : public CObj, public TimerSystemInterface, public IService {
   struct tvec tv3_;
   struct tvec tv4_;
   struct tvec tv5_;
+  // 超过tv5范围(MAX_TVAL)的timer, 按expires排序, 进入范围后迁移到tv5,
+  // 不再像Linux那样截断到MAX_TVAL. 堆满时退化为截断.
+  TimerHeap<TIMER_OVERFLOW_CAPACITY> overflow_;
+  // SetNamedTimer的(action, key)索引
+  TimerNameIndex<TIMER_NAME_INDEX_CAPACITY> names_;
 
   DECLARE_IDCREATE(TimerSystem);
 };
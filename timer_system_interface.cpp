@@ -4,6 +4,123 @@
 #include <iostream>
 #include <locale>
 #include <sstream>
+#include "heap_timer_system.h"
 #include "lib_math.h"
+#include "timer_group.h"
+#include "timer_system.h"
 
 // https://en.cppreference.com/w/cpp/locale/time_get
+
+TimerSystemInterface* CreateTimerSystem(TimerBackend backend, int64_t jiffies) {
+  TimerSystemInterface* timers = nullptr;
+  switch (backend) {
+    case TIMER_BACKEND_WHEEL:
+      timers = dynamic_cast<TimerSystem*>(TimerSystem::CreateObject());
+      break;
+    case TIMER_BACKEND_HEAP:
+      timers = dynamic_cast<HeapTimerSystem*>(HeapTimerSystem::CreateObject());
+      break;
+    default:
+      break;
+  }
+  if (timers) {
+    timers->Init(jiffies);
+  }
+  return timers;
+}
+
+int TimerSystemInterface::CreateTimerGroup() {
+  TimerGroup* group = dynamic_cast<TimerGroup*>(CIDRuntimeClass::CreateObj(EOT_OBJ_TIMER_GROUP));
+  if (!group) {
+    return INVALID_ID;
+  }
+  group->SetOwnerID(SystemID());
+  return group->GetGlobalID();
+}
+
+int TimerSystemInterface::DestroyTimerGroup(int32_t group_id) {
+  if (ClearTimerGroup(group_id) < 0) {
+    return -1;
+  }
+  CIDRuntimeClass::DestroyObj(CIDRuntimeClass::GetObjFromGlobalID(group_id, EOT_OBJ_TIMER_GROUP));
+  return 0;
+}
+
+int TimerSystemInterface::JoinTimerGroup(int32_t timer_id, int32_t group_id) {
+  Timer* timer = LookupTimer(timer_id);
+  TimerGroup* group = LookupTimerGroup(group_id);
+  if (!timer || !group) {
+    return -1;
+  }
+  group->Add(timer);
+  return 0;
+}
+
+int TimerSystemInterface::SetGroupTimer(int32_t group_id, ExpiryAction* action, int64_t expires,
+                                        int64_t interval /* = 0*/, int64_t user_data /* = 0*/) {
+  TimerGroup* group = LookupTimerGroup(group_id);
+  if (!group) {
+    return INVALID_ID;
+  }
+  Timer* timer = InternalSetTimer(action, expires, interval, user_data);
+  if (!timer) {
+    return INVALID_ID;
+  }
+  group->Add(timer);
+  return timer->TimerID();
+}
+
+int32_t TimerSystemInterface::TimerGroupSize(int32_t group_id) {
+  TimerGroup* group = LookupTimerGroup(group_id);
+  if (!group) {
+    return -1;
+  }
+  return group->Size();
+}
+
+Timer* TimerSystemInterface::LookupTimer(int32_t timer_id) {
+  Timer* timer = Timer::FromTimerID(timer_id, TimerIDsEncoded());
+  if (!timer || timer->Dead() || timer->OwnerID() != SystemID() ||
+      timer->Epoch() != CurrentEpoch()) {
+    return nullptr;
+  }
+  return timer;
+}
+
+TimerGroup* TimerSystemInterface::LookupTimerGroup(int32_t group_id) {
+  TimerGroup* group =
+      dynamic_cast<TimerGroup*>(CIDRuntimeClass::GetObjFromGlobalID(group_id, EOT_OBJ_TIMER_GROUP));
+  if (!group || group->OwnerID() != SystemID()) {
+    return nullptr;
+  }
+  return group;
+}
+
+int TimerSystemInterface::SetTimer(const TimerSite& site, ExpiryAction* action, int64_t expires,
+                                   int64_t interval /* = 0*/, int64_t user_data /* = 0*/) {
+  Timer* timer = InternalSetTimer(action, expires, interval, user_data, true);
+  if (!timer) {
+    return INVALID_ID;
+  }
+  TagTimer(timer, site);
+  return timer->TimerID();
+}
+
+std::string TimerSystemInterface::TimerSiteReport(int top_n) {
+  std::vector<TimerSiteStat> stats;
+  sites_.TopN(top_n, &stats);
+  int64_t elapsed = NowMs() - sites_.SinceMs();
+  double seconds = elapsed > 0 ? elapsed / 1000.0 : 1.0;
+  std::string report = format_string("timer sites(sites:%d, since:%.1fs):\n", sites_.Size(),
+                                     elapsed > 0 ? seconds : 0.0);
+  for (const TimerSiteStat& stat : stats) {
+    std::string name = stat.name ? stat.name : format_string("site:%08x", stat.site_id);
+    report += format_string("  %-40s live:%ld created:%ld(%.1f/s) cleared:%ld(%.1f/s)\n",
+                            name.c_str(), stat.live, stat.created, stat.created / seconds,
+                            stat.cleared, stat.cleared / seconds);
+  }
+  if (sites_.Dropped()) {
+    report += format_string("  dropped(site table full):%ld\n", sites_.Dropped());
+  }
+  return report;
+}
@@ -5,23 +5,102 @@
 #pragma once
 
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "expiry_action.h"
 #include "lib_time.h"
+#include "linux_like_bitops.h"
+#include "timer.h"
+#include "timer_site.h"
+
+// 时间轮适合大量timer, 堆适合只有几百个且超时分布很散的timer, 见timer_bench --engine
+enum TimerBackend {
+  TIMER_BACKEND_WHEEL = 0,  // TimerSystem
+  TIMER_BACKEND_HEAP = 1,   // HeapTimerSystem
+};
+
+// 有timer加入或重新挂载时回调, 事件循环适配器(timer_event_loop.h)用它把唤醒时间提前
+class TimerArmListener {
+ public:
+  virtual ~TimerArmListener() = default;
+  // @expires 新挂载timer的超时jiffies
+  virtual void OnTimerArmed(int64_t expires) = 0;
+};
+
+// 每次RunTimers开始时回调, 跨进程命令队列(timer_remote.h)用它在处理到期之前先执行积压的命令
+class TimerRunListener {
+ public:
+  virtual ~TimerRunListener() = default;
+  // @jiffies 本次RunTimers的参数
+  virtual void OnRunTimers(int64_t jiffies) = 0;
+};
+
+// timer系统的时间源, 默认用GetRealTickTimeMs(). 注入后SetTimer/ResetTimer等按它计算超时,
+// 调用方同样要用它的时间调用RunTimers. 模拟用的虚拟时钟见timer_simulator.h
+class TimerClock {
+ public:
+  virtual ~TimerClock() = default;
+  // 当前时间, 和jiffies同一单位(ms)
+  virtual int64_t NowMs() = 0;
+};
+
+// 同一时刻大量timer的打散策略, 见TimerSystemInterface::SetSpreadPolicy
+struct TimerSpreadPolicy {
+  int64_t window;     // 打散窗口Millis, 0表示关闭
+  int64_t min_delay;  // 超时不小于这个值的timer才打散
+  int32_t slot_cap;   // 时间轮cascade进tv1时每个槽最多接收的打散timer数, 0表示不限
+};
+
+class TimerGroup;
 
 class TimerSystemInterface {
  public:
   virtual ~TimerSystemInterface() = default;
 
+  // 本timer系统的globalid. timer和组都记下创建它们的系统, 别的系统的timer/组一律拒绝
+  virtual int32_t SystemID() = 0;
+
   virtual int Init(int64_t jiffies) = 0;
   virtual void RunTimers(int64_t jiffies) = 0;
 
+  // 下一次RunTimers有timer要处理的jiffies, 可能早于真正的超时(时间轮的cascade点), 不会晚于它
+  // @return 没有timer返回-1
+  virtual int64_t NextExpiry() = 0;
+
+  // 按timer id取本系统的timer对象, 回调里用. 不存在, 已释放, 被slab复用过, 被ClearAll作废
+  // 或属于别的系统时返回nullptr
+  Timer* GetTimer(int32_t timer_id) { return LookupTimer(timer_id); }
+
+  // 进程内指针, resume后需要重新设置. nullptr表示不通知
+  void SetArmListener(TimerArmListener* listener) { arm_listener_ = listener; }
+  TimerArmListener* ArmListener() const { return arm_listener_; }
+  // 同上, 进程内指针, resume后需要重新设置
+  void SetRunListener(TimerRunListener* listener) { run_listener_ = listener; }
+  // 同上, 进程内指针, resume后需要重新设置. nullptr表示用GetRealTickTimeMs().
+  // 每个实例可以有自己的时钟, 同一进程里的多个timer系统互不影响
+  void SetClock(TimerClock* clock) { clock_ = clock; }
+  int64_t NowMs() { return likely(clock_ == nullptr) ? GetRealTickTimeMs() : clock_->NowMs(); }
+
+  // 打散同一时刻的大量timer(每日重置, 赛季结束, 全服buff): 开启后超时不小于min_delay的
+  // SetTimer(action, ...)/ResetTimer(timer_id, action, ...)按hash(user_data)推迟[0, window)ms,
+  // user_data为0时按timer的obj_id, 同一个user_data总是得到同一个偏移. 时间轮后端在cascade进
+  // tv1时还会限制每个槽的打散timer数, 超过slot_cap的顺延到后面有空位的槽. 对精度敏感的短timer
+  // 用min_delay排除. 具名timer, 组timer, 内联回调(包括协程), SetTimerAt和cron要么有明确的
+  // 时间点, 要么没有稳定的key, 一律不打散.
+  // 策略存在共享内存里, resume后保留. window=0关闭
+  void SetSpreadPolicy(int64_t window, int64_t min_delay = 1000, int32_t slot_cap = 0) {
+    spread_.window = window > 0 ? window : 0;
+    spread_.min_delay = min_delay;
+    spread_.slot_cap = slot_cap > 0 ? slot_cap : 0;
+  }
+  const TimerSpreadPolicy& SpreadPolicy() { return spread_; }
+
   // interface:
   // @expires 超时时间，距离当前时间的Millis, 小于0的值会被修正为0
   // @interval 循环间隔Milliseconds, interval = 0表示非循环, 小于0的值会被修正为0
   // @return
-  // 返回timer的globalid,
-  // 可用dynamic_cast<Timer*>(CIDRuntimeClass::GetObjFromGlobalID(timer_globalid,
-  // EOT_OBJ_TIMER))获取对象
+  // 返回timer id, 可用GetTimer获取对象
 
   virtual int SetTimer(ExpiryAction* action, int64_t expires, int64_t interval = 0,
                        int64_t user_data = 0) = 0;
@@ -36,21 +115,61 @@ class TimerSystemInterface {
   // {Min(10)}
   // @interval 循环间隔, interval = 0表示非循环, 小于0的值会被修正为0
   // @return
-  // 返回timer的globalid,
-  // 可用dynamic_cast<Timer*>(CIDRuntimeClass::GetObjFromGlobalID(timer_globalid,
-  // EOT_OBJ_TIMER))获取对象
+  // 返回timer id, 可用GetTimer获取对象
   virtual int SetTimer(ExpiryAction* action, TimeHelper expiry_time,
                        TimeHelper interval = {Millis(0)}, int64_t user_data = 0) {
     return SetTimer(action, expiry_time.GetMillis(), interval.GetMillis(), user_data);
   }
 
+  // 内联回调timer, 不需要ExpiryAction子类, 见timer_callback.h
+  // @callback 带key的函数对象或TIMER_CALLBACK包起来的lambda, 签名void(int32_t timer_globalid),
+  // 可平凡拷贝, 不超过TIMER_INLINE_PAYLOAD_SIZE字节, 捕获的状态随timer存在共享内存里
+  // @examples: SetTimer(TIMER_CALLBACK("login_timeout", [uid](int32_t) { OnLogout(uid); }), 5000)
+  // 其他参数和返回值同SetTimer
+  template <typename F, typename = decltype(std::declval<F&>()(int32_t()))>
+  int SetTimer(F callback, int64_t expires, int64_t interval = 0) {
+    Timer* timer = InternalSetCallbackTimer(callback, expires, interval);
+    return timer ? timer->TimerID() : INVALID_ID;
+  }
+  template <typename F, typename = decltype(std::declval<F&>()(int32_t()))>
+  int SetTimer(F callback, TimeHelper expiry_time, TimeHelper interval = {Millis(0)}) {
+    return SetTimer(callback, expiry_time.GetMillis(), interval.GetMillis());
+  }
+
+  // 记录创建位置的SetTimer, 按site统计live/created/cleared, 见timer_site.h
+  // @site TIMER_HERE()或调用方的静态TimerSite
+  // 其他参数和返回值同SetTimer
+  int SetTimer(const TimerSite& site, ExpiryAction* action, int64_t expires, int64_t interval = 0,
+               int64_t user_data = 0);
+  int SetTimer(const TimerSite& site, ExpiryAction* action, TimeHelper expiry_time,
+               TimeHelper interval = {Millis(0)}, int64_t user_data = 0) {
+    return SetTimer(site, action, expiry_time.GetMillis(), interval.GetMillis(), user_data);
+  }
+  template <typename F, typename = decltype(std::declval<F&>()(int32_t()))>
+  int SetTimer(const TimerSite& site, F callback, int64_t expires, int64_t interval = 0) {
+    Timer* timer = InternalSetCallbackTimer(callback, expires, interval);
+    if (!timer) {
+      return INVALID_ID;
+    }
+    TagTimer(timer, site);
+    return timer->TimerID();
+  }
+
+  // 按live倒序返回前top_n个创建位置的统计, 只包含带TimerSite创建的timer. top_n<0表示全部
+  void TimerSiteStats(int top_n, std::vector<TimerSiteStat>* out) const { sites_.TopN(top_n, out); }
+  // 每个site一行: live, created/cleared以及它们从上次ResetTimerSiteStats到现在的每秒速率
+  std::string TimerSiteReport(int top_n);
+  // created/cleared清零, 从现在开始重新计算速率, live保留
+  void ResetTimerSiteStats() { sites_.ResetCounters(NowMs()); }
+
   // 清除timer
-  // @timer_id timer的globalid
+  // @timer_id timer id
   virtual int ClearTimer(int32_t timer_id) = 0;
 
   // 重置timer
-  // @timer_id timer的globalid
+  // @timer_id timer id
   // 其他参数同Start, 重置timer的参数, 以调用时刻重新计算超时
+  // 具名timer换了action后退出具名索引, 之后按新action也找不到它
   // @return 0=success, <0=failed.
   virtual int ResetTimer(int32_t timer_id, ExpiryAction* action, int64_t expires,
                          int64_t interval = 0, int64_t user_data = 0) = 0;
@@ -58,4 +177,123 @@ class TimerSystemInterface {
                          TimeHelper interval = {Millis(0)}, int64_t user_data = 0) {
     return ResetTimer(timer_id, action, expiry_time.GetMillis(), interval.GetMillis(), user_data);
   }
+
+  // 推迟timer的超时, 适合每收一个包就要续期的idle/keepalive timer
+  // @timer_id timer id
+  // @expires 新的超时时间, 距离当前时间的Millis, 小于0的值会被修正为0
+  // 新超时晚于当前超时时只记录下来, timer到达旧槽时再按新超时重新挂载, 不做摘链和重挂;
+  // 早于当前超时时等同于ModTimer. action/interval/user_data保持不变.
+  // @return 0=success, <0=failed.
+  virtual int TouchTimer(int32_t timer_id, int64_t expires) = 0;
+  virtual int TouchTimer(int32_t timer_id, TimeHelper expiry_time) {
+    return TouchTimer(timer_id, expiry_time.GetMillis());
+  }
+
+  // timer组: 一个实体的timer都加到同一个组里, 实体销毁时ClearTimerGroup一次清掉, 见TimerGroup
+  // 组只属于创建它的timer系统, 以下接口对别的系统的组和timer都返回失败
+  // @return 组的globalid, 失败返回INVALID_ID
+  int CreateTimerGroup();
+  // 清除组内所有timer并销毁组
+  // @return 0=success, <0=failed.
+  int DestroyTimerGroup(int32_t group_id);
+  // 把timer加入组, 已经在别的组里的会先退出, 一个timer同时只属于一个组
+  // @return 0=success, <0=failed.
+  int JoinTimerGroup(int32_t timer_id, int32_t group_id);
+  // 同SetTimer, 创建成功后加入组
+  int SetGroupTimer(int32_t group_id, ExpiryAction* action, int64_t expires, int64_t interval = 0,
+                    int64_t user_data = 0);
+  // @return 组内timer数, 组不存在返回-1
+  int32_t TimerGroupSize(int32_t group_id);
+
+  // 清除组内所有timer, 组本身保留可以继续使用. 沿组内链表遍历, 不做逐个id查找
+  // @return 清除的timer数, 组不存在返回-1
+  virtual int ClearTimerGroup(int32_t group_id) = 0;
+
+  // 具名timer: 同一个(action, key)最多只有一个timer, 索引和timer一起放在共享内存里, resume后可用.
+  // 已存在时按新参数重置它(同ResetTimer), 否则新建. 其他参数同SetTimer
+  // @return timer id, 索引满或创建失败返回INVALID_ID
+  virtual int SetNamedTimer(ExpiryAction* action, int64_t key, int64_t expires,
+                            int64_t interval = 0, int64_t user_data = 0) = 0;
+  // @return 0=success, <0=不存在
+  virtual int ClearNamedTimer(ExpiryAction* action, int64_t key) = 0;
+  // @return timer id, 不存在返回INVALID_ID
+  virtual int FindNamedTimer(ExpiryAction* action, int64_t key) = 0;
+
+ protected:
+  // 创建并加入一个timer, 参数同SetTimer
+  // @spread 是否按打散策略推迟, 只有普通的SetTimer/ResetTimer入口打散, 具名/组/内联/cron/
+  // SetTimerAt等内部调用一律不打散
+  // @return 失败返回nullptr
+  virtual Timer* InternalSetTimer(ExpiryAction* action, int64_t expires, int64_t interval,
+                                  int64_t user_data, bool spread = false) = 0;
+
+  // 按timer id查找本系统的timer, 不存在, 已释放(DEAD), 被slab复用, 被ClearAll作废或属于别的
+  // 系统时返回nullptr
+  Timer* LookupTimer(int32_t timer_id);
+  // 新建timer记录的epoch, 和它不相等的timer已经被ClearAll作废. 没有ClearAll的后端总是0
+  virtual uint16_t CurrentEpoch() { return 0; }
+  // timer id里是否可能带generation(见TIMER_ID_REUSED), 只有开过slab的时间轮后端返回true.
+  // 为false时timer id就是globalid, 不解码
+  virtual bool TimerIDsEncoded() { return false; }
+  // 按globalid查找本系统的组, 不存在或属于别的系统时返回nullptr
+  TimerGroup* LookupTimerGroup(int32_t group_id);
+
+  // 创建并加入一个内联回调timer, 参数同SetTimer
+  // @return 失败返回nullptr
+  template <typename F>
+  Timer* InternalSetCallbackTimer(F callback, int64_t expires, int64_t interval) {
+    static_assert(std::is_trivially_copyable<F>::value,
+                  "timer callback must be trivially copyable");
+    static_assert(sizeof(F) <= TIMER_INLINE_PAYLOAD_SIZE, "timer callback payload too large");
+    static_assert(alignof(F) <= 8, "timer callback over aligned");
+    static_assert(HasTimerCallbackKey<F>::value,
+                  "timer callback needs a stable key, use TIMER_CALLBACK(key, lambda)");
+    Timer* timer = InternalSetTimer(nullptr, expires, interval, 0);
+    if (timer) {
+      timer->SetCallback(callback);
+    }
+    return timer;
+  }
+
+  // 记录新建timer的创建位置
+  void TagTimer(Timer* timer, const TimerSite& site) {
+    timer->SetSiteID(site.ID());
+    sites_.OnCreate(site.ID());
+  }
+  // timer被主动清除时调用, 没有创建位置的timer只多一次判0
+  void OnSiteClear(Timer* timer) {
+    if (unlikely(timer->SiteID() != 0))
+      sites_.OnClear(timer->SiteID());
+  }
+  // timer释放时调用
+  void OnSiteRelease(Timer* timer) {
+    if (unlikely(timer->SiteID() != 0))
+      sites_.OnRelease(timer->SiteID());
+  }
+
+  // 按打散策略推迟expires
+  // @key 决定偏移的值, 一般是user_data
+  // @return 是否打散了
+  bool SpreadExpires(int64_t* expires, int64_t key) const {
+    if (likely(spread_.window == 0) || *expires < spread_.min_delay)
+      return false;
+    uint64_t h = static_cast<uint64_t>(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    *expires += static_cast<int64_t>(h % static_cast<uint64_t>(spread_.window));
+    return true;
+  }
+
+  TimerArmListener* arm_listener_ = nullptr;
+  TimerRunListener* run_listener_ = nullptr;
+  TimerClock* clock_ = nullptr;
+  // 没有默认初始化, resume时保留, 由各backend的CreateInit清零
+  TimerSpreadPolicy spread_;
+  // 同上, 由各backend的CreateInit清空
+  TimerSiteTable sites_;
 };
+
+// 按backend创建一个timer系统并Init, 对象分配在共享内存里, 用CIDRuntimeClass::DestroyObj释放
+// @return 失败返回nullptr
+TimerSystemInterface* CreateTimerSystem(TimerBackend backend, int64_t jiffies);
@@ -0,0 +1,231 @@
+#include "timer_trace.h"
+#include <string.h>
+
+TimerTraceWriter::TimerTraceWriter() {
+  fp_ = nullptr;
+  has_last_ = false;
+  last_jiffies_ = 0;
+  last_system_id_ = 0;
+  records_ = 0;
+  len_ = 0;
+}
+
+TimerTraceWriter::~TimerTraceWriter() { Close(); }
+
+int TimerTraceWriter::Open(const char* path) {
+  Close();
+  fp_ = fopen(path, "wb");
+  if (!fp_) {
+    return -1;
+  }
+  has_last_ = false;
+  last_jiffies_ = 0;
+  last_system_id_ = 0;
+  records_ = 0;
+  len_ = 0;
+  return 0;
+}
+
+void TimerTraceWriter::Close() {
+  if (!fp_)
+    return;
+  Flush();
+  fclose(fp_);
+  fp_ = nullptr;
+}
+
+void TimerTraceWriter::Flush() {
+  if (len_ > 0) {
+    fwrite(buffer_, 1, len_, fp_);
+    len_ = 0;
+  }
+}
+
+void TimerTraceWriter::PutVarint(uint64_t value) {
+  while (value >= 0x80) {
+    buffer_[len_++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  buffer_[len_++] = static_cast<uint8_t>(value);
+}
+
+void TimerTraceWriter::Write(const TimerTraceRecord& record) {
+  if (!fp_)
+    return;
+  // 第一条记录写入时才知道起始jiffies
+  if (!has_last_) {
+    TimerTraceHeader header;
+    header.magic = TIMER_TRACE_MAGIC;
+    header.version = TIMER_TRACE_VERSION;
+    header.start_jiffies = record.jiffies;
+    fwrite(&header, sizeof(header), 1, fp_);
+    has_last_ = true;
+    last_jiffies_ = record.jiffies;
+    last_system_id_ = ~record.system_id;
+  }
+  // 单条记录最多1 + 10 * 10字节, 加上切换记录1 + 10字节
+  if (len_ + 160 > sizeof(buffer_)) {
+    Flush();
+  }
+  if (record.system_id != last_system_id_) {
+    buffer_[len_++] = static_cast<uint8_t>(TIMER_TRACE_SYSTEM);
+    PutSigned(record.system_id);
+    last_system_id_ = record.system_id;
+  }
+
+  buffer_[len_++] = static_cast<uint8_t>(record.op);
+  PutSigned(record.jiffies - last_jiffies_);
+  last_jiffies_ = record.jiffies;
+  switch (record.op) {
+    case TIMER_TRACE_SET:
+    case TIMER_TRACE_RESET:
+    case TIMER_TRACE_SET_AT:
+      PutSigned(record.timer_id);
+      PutSigned(record.expires);
+      PutSigned(record.interval);
+      PutSigned(record.user_data);
+      break;
+    case TIMER_TRACE_CLEAR:
+      PutSigned(record.timer_id);
+      break;
+    case TIMER_TRACE_TOUCH:
+      PutSigned(record.timer_id);
+      PutSigned(record.expires);
+      break;
+    case TIMER_TRACE_CRON:
+      PutSigned(record.timer_id);
+      PutSigned(record.expires);
+      PutSigned(record.user_data);
+      PutVarint(record.cron.minutes);
+      PutVarint(record.cron.hours);
+      PutVarint(record.cron.days);
+      PutVarint(record.cron.months);
+      PutVarint(record.cron.weekdays);
+      PutVarint(record.cron.flags);
+      break;
+    default:
+      break;
+  }
+  records_++;
+}
+
+TimerTraceReader::TimerTraceReader() {
+  fp_ = nullptr;
+  memset(&header_, 0, sizeof(header_));
+  last_jiffies_ = 0;
+  system_id_ = 0;
+}
+
+TimerTraceReader::~TimerTraceReader() { Close(); }
+
+int TimerTraceReader::Open(const char* path) {
+  Close();
+  fp_ = fopen(path, "rb");
+  if (!fp_) {
+    return -1;
+  }
+  if (fread(&header_, sizeof(header_), 1, fp_) != 1 || header_.magic != TIMER_TRACE_MAGIC ||
+      header_.version < 1 || header_.version > TIMER_TRACE_VERSION) {
+    Close();
+    return -2;
+  }
+  last_jiffies_ = header_.start_jiffies;
+  system_id_ = 0;
+  return 0;
+}
+
+void TimerTraceReader::Close() {
+  if (fp_) {
+    fclose(fp_);
+    fp_ = nullptr;
+  }
+}
+
+bool TimerTraceReader::GetVarint(uint64_t* value) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = getc_unlocked(fp_);
+    if (c == EOF)
+      return false;
+    result |= static_cast<uint64_t>(c & 0x7F) << shift;
+    if (!(c & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TimerTraceReader::GetSigned(int64_t* value) {
+  uint64_t raw;
+  if (!GetVarint(&raw))
+    return false;
+  *value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+  return true;
+}
+
+bool TimerTraceReader::Next(TimerTraceRecord* record) {
+  if (!fp_)
+    return false;
+  int op = getc_unlocked(fp_);
+  while (op == TIMER_TRACE_SYSTEM) {
+    int64_t system_id;
+    if (!GetSigned(&system_id))
+      return false;
+    system_id_ = static_cast<int32_t>(system_id);
+    op = getc_unlocked(fp_);
+  }
+  if (op == EOF)
+    return false;
+
+  memset(record, 0, sizeof(*record));
+  record->op = op;
+  record->system_id = system_id_;
+  int64_t delta;
+  if (!GetSigned(&delta))
+    return false;
+  last_jiffies_ += delta;
+  record->jiffies = last_jiffies_;
+
+  int64_t timer_id = 0;
+  switch (op) {
+    case TIMER_TRACE_SET:
+    case TIMER_TRACE_RESET:
+    case TIMER_TRACE_SET_AT:
+      if (!GetSigned(&timer_id) || !GetSigned(&record->expires) ||
+          !GetSigned(&record->interval) || !GetSigned(&record->user_data))
+        return false;
+      break;
+    case TIMER_TRACE_CLEAR:
+      if (!GetSigned(&timer_id))
+        return false;
+      break;
+    case TIMER_TRACE_TOUCH:
+      if (!GetSigned(&timer_id) || !GetSigned(&record->expires))
+        return false;
+      break;
+    case TIMER_TRACE_TICK:
+    case TIMER_TRACE_CLEAR_ALL:
+      break;
+    case TIMER_TRACE_CRON: {
+      uint64_t fields[6];
+      if (!GetSigned(&timer_id) || !GetSigned(&record->expires) || !GetSigned(&record->user_data))
+        return false;
+      for (uint64_t& field : fields) {
+        if (!GetVarint(&field))
+          return false;
+      }
+      record->cron.minutes = fields[0];
+      record->cron.hours = static_cast<uint32_t>(fields[1]);
+      record->cron.days = static_cast<uint32_t>(fields[2]);
+      record->cron.months = static_cast<uint16_t>(fields[3]);
+      record->cron.weekdays = static_cast<uint8_t>(fields[4]);
+      record->cron.flags = static_cast<uint8_t>(fields[5]);
+      break;
+    }
+    default:
+      return false;
+  }
+  record->timer_id = static_cast<int32_t>(timer_id);
+  return true;
+}
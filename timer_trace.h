@@ -0,0 +1,117 @@
+// @brief Timer操作的二进制trace
+// TimerSystem开启trace后把SetTimer/SetTimerAt/SetCronTimer/ClearTimer/ResetTimer/TouchTimer/
+// ClearAll/RunTimers连同jiffies写进文件,
+// timer_replay用它驱动一个新的时间轮, 把线上的负载形态变成可重复的性能测试.
+// 进程内所有开启trace的timer系统写同一个文件, 每条记录带着写它的系统.
+//
+// 文件格式: TimerTraceHeader + 若干条记录, 每条记录为
+//   op(1 byte) + jiffies相对上一条的增量(zigzag varint) + op相关字段(zigzag varint)
+//   SET/RESET/SET_AT: timer_id, expires, interval, user_data. SET_AT的expires是按录制时的
+//                     时间偏移换算出的相对超时, 回放时按回放进程的逻辑时间重建
+//   CLEAR:     timer_id
+//   TOUCH:     timer_id, expires
+//   TICK:      无
+//   CRON:      timer_id, expires(第一次触发的相对超时), user_data,
+//              CronSchedule的minutes, hours, days, months, weekdays, flags(varint)
+//   CLEAR_ALL: 无
+// 写入的系统和上一条不同时先写一条op(1 byte)为SYSTEM的切换记录, 后面跟system_id(zigzag
+// varint), 没有jiffies; 之后的记录都属于这个系统. 读出的记录不包括切换记录.
+//  @author justinzhu
+//  @date 2026年10月19日15:40:12
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "singleton.h"
+#include "timer_cron.h"
+
+#define TIMER_TRACE_MAGIC (0x52544D54)  // "TMTR"
+// 1没有CRON, 2没有CLEAR_ALL, 3没有SET_AT和SYSTEM(system_id读出为0), 仍然可以读
+#define TIMER_TRACE_VERSION (4)
+#define TIMER_TRACE_BUFFER_SIZE (64 * 1024)
+
+enum TimerTraceOp {
+  TIMER_TRACE_SET = 1,
+  TIMER_TRACE_CLEAR = 2,
+  TIMER_TRACE_RESET = 3,
+  TIMER_TRACE_TICK = 4,
+  TIMER_TRACE_TOUCH = 5,
+  TIMER_TRACE_CRON = 6,
+  TIMER_TRACE_CLEAR_ALL = 7,
+  TIMER_TRACE_SET_AT = 8,
+  TIMER_TRACE_SYSTEM = 9,  // 切换后续记录所属的系统, 只在文件里出现
+  TIMER_TRACE_OP_MAX,
+};
+
+struct TimerTraceHeader {
+  uint32_t magic;
+  uint32_t version;
+  int64_t start_jiffies;  // 第一条记录的jiffies
+};
+
+struct TimerTraceRecord {
+  int32_t op;
+  int32_t system_id;  // 写这条记录的TimerSystem::SystemID()
+  int64_t jiffies;
+  int32_t timer_id;  // 录制时的timer id, 回放时需要重新映射
+  int64_t expires;   // SetTimer/ResetTimer/TouchTimer的相对超时, 单位ms
+  int64_t interval;
+  int64_t user_data;
+  CronSchedule cron;  // 只有CRON有效
+};
+
+class TimerTraceWriter {
+ public:
+  TimerTraceWriter();
+  ~TimerTraceWriter();
+
+  int Open(const char* path);
+  void Close();
+  bool Recording() const { return fp_ != nullptr; }
+  int64_t Records() const { return records_; }
+
+  void Write(const TimerTraceRecord& record);
+
+ private:
+  void PutVarint(uint64_t value);
+  void PutSigned(int64_t value) { PutVarint((static_cast<uint64_t>(value) << 1) ^ (value >> 63)); }
+  void Flush();
+
+ private:
+  FILE* fp_;
+  bool has_last_;
+  int64_t last_jiffies_;
+  int32_t last_system_id_;
+  int64_t records_;
+  size_t len_;
+  uint8_t buffer_[TIMER_TRACE_BUFFER_SIZE];
+};
+
+class TimerTraceReader {
+ public:
+  TimerTraceReader();
+  ~TimerTraceReader();
+
+  int Open(const char* path);
+  void Close();
+  const TimerTraceHeader& Header() const { return header_; }
+
+  // @return true=读到一条记录, false=文件结束或格式错误
+  bool Next(TimerTraceRecord* record);
+
+ private:
+  bool GetVarint(uint64_t* value);
+  bool GetSigned(int64_t* value);
+
+ private:
+  FILE* fp_;
+  TimerTraceHeader header_;
+  int64_t last_jiffies_;
+  int32_t system_id_;  // 最近一条切换记录的system_id
+};
+
+// 进程内的trace文件, 各TimerSystem通过EnableTrace决定是否往里写
+inline TimerTraceWriter& GetTimerTraceWriter() {
+  return Singleton<TimerTraceWriter>::GetInstance();
+}